@@ -0,0 +1,493 @@
+/*
+Headless benchmark for Source/Pathfinding.h. Needs no Urho3D.
+
+Generates open fields, random wall maps, mazes and spirals at several sizes
+and runs breadth first search, Dijkstra and A* on each, through the hash
+map API and through SearchWorkspace with each frontier, A* as a
+multi-threaded batch, and on maps up to 64 cells wide memory-bounded
+IDA*. One row per case:
+
+	map, size, algorithm, backend, queries, qps, expanded, path_cost,
+	allocs_per_query, peak_bytes
+
+expanded is the average number of nodes expanded per query, path_cost the
+average cost of the paths found, peak_bytes the largest heap footprint the
+case reached, including its workspace. Each case gets one untimed warm-up
+pass, so allocs_per_query is the steady state. The batch rows run on the
+plain grid and do not count expansions.
+
+Usage: PathfindingBenchmark [--format csv|json] [--sizes 64,256,512]
+	[--min-time seconds] [--seed n] [--threads n]
+*/
+
+#include "Pathfinding.h"
+#include "PathBatch.h"
+#include "MemoryBoundedSearch.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+
+// Heap accounting. Every block carries its size in front, so the current
+// and peak footprint can be tracked without platform APIs.
+
+namespace {
+	std::atomic<long long> allocations(0);
+	std::atomic<long long> heap_bytes(0);
+	std::atomic<long long> heap_peak(0);
+	const size_t HEADER = 16;
+}
+
+void* operator new(size_t size) {
+	char* block = static_cast<char*>(std::malloc(size + HEADER));
+	if (!block) {
+		throw std::bad_alloc();
+	}
+	*reinterpret_cast<size_t*>(block) = size;
+	++allocations;
+	long long bytes = heap_bytes += size;
+	long long peak = heap_peak;
+	while (bytes > peak && !heap_peak.compare_exchange_weak(peak, bytes)) {
+	}
+	return block + HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+	if (pointer) {
+		char* block = static_cast<char*>(pointer) - HEADER;
+		heap_bytes -= *reinterpret_cast<size_t*>(block);
+		std::free(block);
+	}
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete[](void* pointer) noexcept {
+	operator delete(pointer);
+}
+
+// Grid wrapper that counts expansions. Every search calls for_each_neighbor
+// once per node it expands.
+template<typename Grid>
+struct CountingGrid : Grid {
+	mutable long long expanded;
+
+	explicit CountingGrid(const Grid& grid) : Grid(grid), expanded(0) {}
+
+	template<typename Visitor>
+	void for_each_neighbor(typename Grid::Location id, Visitor visit) const {
+		++expanded;
+		Grid::for_each_neighbor(id, visit);
+	}
+};
+
+typedef DenseGridWithWeights::Location Location;
+typedef CountingGrid<DenseGridWithWeights> BenchGrid;
+
+// Maps
+
+DenseGridWithWeights make_open(int size, std::mt19937&) {
+	return DenseGridWithWeights(size, size);
+}
+
+// A quarter of the cells are walls and a tenth are forest.
+DenseGridWithWeights make_random(int size, std::mt19937& rng) {
+	DenseGridWithWeights grid(size, size);
+	for (int i = 0; i < grid.size(); ++i) {
+		int roll = int(rng() % 100);
+		if (roll < 25) {
+			grid.add_wall(grid.location(i));
+		}
+		else if (roll < 35) {
+			grid.forests.set(i);
+		}
+	}
+	return grid;
+}
+
+// Depth first maze on the odd cells; corridors are one tile wide.
+DenseGridWithWeights make_maze(int size, std::mt19937& rng) {
+	DenseGridWithWeights grid(size, size);
+	add_rect(grid, 0, 0, size, size);
+	vector<Location> stack(1, Location(1, 1));
+	grid.remove_wall(stack.back());
+	while (!stack.empty()) {
+		int x, y;
+		tie(x, y) = stack.back();
+		array<int, 4> order{ { 0, 1, 2, 3 } };
+		std::shuffle(order.begin(), order.end(), rng);
+		bool moved = false;
+		for (int dir : order) {
+			int dx, dy;
+			tie(dx, dy) = SquareGrid::DIRS[dir];
+			Location next(x + 2 * dx, y + 2 * dy);
+			if (x + 2 * dx > 0 && x + 2 * dx < size - 1 && y + 2 * dy > 0 && y + 2 * dy < size - 1 && !grid.passable(next)) {
+				grid.remove_wall(Location(x + dx, y + dy));
+				grid.remove_wall(next);
+				stack.push_back(next);
+				moved = true;
+				break;
+			}
+		}
+		if (!moved) {
+			stack.pop_back();
+		}
+	}
+	return grid;
+}
+
+// Square spiral of one tile walls with a single gap per ring, so the way
+// from the outside to the center walks every ring.
+DenseGridWithWeights make_spiral(int size, std::mt19937&) {
+	DenseGridWithWeights grid(size, size);
+	for (int ring = 1; 2 * ring < size - 2; ring += 2) {
+		int low = ring, high = size - 1 - ring;
+		add_rect(grid, low, low, high + 1, low + 1);
+		add_rect(grid, low, high, high + 1, high + 1);
+		add_rect(grid, low, low, low + 1, high + 1);
+		add_rect(grid, high, low, high + 1, high + 1);
+		// alternate the gap between the top and bottom edge
+		grid.remove_wall(Location(size / 2, (ring / 2) % 2 == 0 ? low : high));
+	}
+	return grid;
+}
+
+struct MapKind {
+	const char* name;
+	DenseGridWithWeights (*make)(int, std::mt19937&);
+};
+
+// First query is the worst case for the map: corner to opposite corner,
+// or outside to center on the spiral. The rest are random open cells.
+vector<pair<Location, Location> > make_queries(const DenseGridWithWeights& grid, bool spiral, int count, std::mt19937& rng) {
+	vector<pair<Location, Location> > queries;
+	vector<int> open;
+	for (int i = 0; i < grid.size(); ++i) {
+		if (grid.passable(grid.location(i))) {
+			open.push_back(i);
+		}
+	}
+	if (open.empty()) {
+		return queries;
+	}
+	Location center(grid.width / 2, grid.height / 2);
+	if (spiral && grid.passable(center)) {
+		queries.emplace_back(Location(0, 0), center);
+	}
+	else {
+		queries.emplace_back(grid.location(open.front()), grid.location(open.back()));
+	}
+	while (int(queries.size()) < count) {
+		queries.emplace_back(grid.location(open[rng() % open.size()]), grid.location(open[rng() % open.size()]));
+	}
+	return queries;
+}
+
+// Results
+
+struct Options {
+	bool json;
+	vector<int> sizes;
+	double min_time;
+	unsigned seed;
+	// batch threads, 0 for one per core
+	int threads;
+
+	Options() : json(false), min_time(0.25), seed(1), threads(0) {
+		sizes.push_back(64);
+		sizes.push_back(256);
+		sizes.push_back(512);
+		sizes.push_back(1024);
+	}
+};
+
+struct Result {
+	long long queries;
+	double seconds;
+	long long expanded;
+	long long cost;
+	long long found;
+	long long allocations;
+	long long peak_bytes;
+};
+
+void print_header(const Options& options) {
+	if (!options.json) {
+		std::printf("map,size,algorithm,backend,queries,qps,expanded,path_cost,allocs_per_query,peak_bytes\n");
+	}
+}
+
+void print_result(const Options& options, const char* map, int size, const char* algorithm, const char* backend, const Result& result) {
+	double qps = result.queries / std::max(result.seconds, 1e-9);
+	double expanded = double(result.expanded) / std::max(result.queries, 1LL);
+	double cost = double(result.cost) / std::max(result.found, 1LL);
+	double allocs = double(result.allocations) / std::max(result.queries, 1LL);
+	const char* format = options.json
+		? "{\"map\":\"%s\",\"size\":%d,\"algorithm\":\"%s\",\"backend\":\"%s\",\"queries\":%lld,\"qps\":%.1f,"
+		"\"expanded\":%.1f,\"path_cost\":%.1f,\"allocs_per_query\":%.1f,\"peak_bytes\":%lld}\n"
+		: "%s,%d,%s,%s,%lld,%.1f,%.1f,%.1f,%.1f,%lld\n";
+	std::printf(format, map, size, algorithm, backend, result.queries, qps, expanded, cost, allocs, result.peak_bytes);
+	std::fflush(stdout);
+}
+
+// Runs query(start, goal, cost) over the query list until min_time has
+// passed. query returns whether a path was found and sets its cost. Memory
+// allocated since heap_base, e.g. a workspace, counts towards the peak.
+template<typename Query>
+Result run(const Options& options, const BenchGrid& grid, const vector<pair<Location, Location> >& queries,
+	Query query, long long heap_base = -1) {
+	Result result = Result();
+	long long heap_before = heap_base >= 0 ? heap_base : heap_bytes.load();
+	heap_peak = heap_bytes.load();
+	for (auto& q : queries) {
+		int cost = 0;
+		query(q.first, q.second, cost);
+	}
+	long long allocations_before = allocations;
+	grid.expanded = 0;
+
+	auto begin = std::chrono::steady_clock::now();
+	do {
+		for (auto& q : queries) {
+			int cost = 0;
+			if (query(q.first, q.second, cost)) {
+				result.cost += cost;
+				++result.found;
+			}
+			++result.queries;
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	} while (result.seconds < options.min_time);
+
+	result.expanded = grid.expanded;
+	result.allocations = allocations - allocations_before;
+	result.peak_bytes = heap_peak - heap_before;
+	return result;
+}
+
+template<typename Frontier>
+void run_workspace(const Options& options, const char* map, const BenchGrid& grid,
+	const vector<pair<Location, Location> >& queries, const char* backend) {
+	long long heap_base = heap_bytes;
+	SearchWorkspace<BenchGrid, Frontier> workspace(grid);
+	Result result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!dijkstra_search(grid, start, goal, workspace)) {
+			return false;
+		}
+		cost = workspace.cost_so_far[grid.index(goal)];
+		return true;
+	}, heap_base);
+	print_result(options, map, grid.width, "dijkstra", backend, result);
+
+	SearchWorkspace<BenchGrid, Frontier> backward(grid);
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!bidirectional_dijkstra_search(grid, start, goal, workspace, backward)) {
+			return false;
+		}
+		cost = workspace.cost_so_far[grid.index(goal)];
+		return true;
+	}, heap_base);
+	print_result(options, map, grid.width, "bidijkstra", backend, result);
+
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!a_star_search(grid, start, goal, workspace)) {
+			return false;
+		}
+		cost = workspace.cost_so_far[grid.index(goal)];
+		return true;
+	}, heap_base);
+	print_result(options, map, grid.width, "astar", backend, result);
+}
+
+// IDA* with a fixed transposition table. A query that hits the expansion
+// limit counts as not found.
+void run_ida(const Options& options, const char* map, const BenchGrid& grid,
+	const vector<pair<Location, Location> >& queries) {
+	enum { TABLE_ENTRIES = 1 << 16 };
+	long long heap_base = heap_bytes;
+	IDAStarWorkspace<BenchGrid> workspace(TABLE_ENTRIES);
+	workspace.expansion_limit = 1 << 22;
+	Result result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!ida_star_search(grid, start, goal, workspace)) {
+			return false;
+		}
+		cost = workspace.cost;
+		return true;
+	}, heap_base);
+	char backend[32];
+	std::snprintf(backend, sizeof(backend), "table_%d", int(TABLE_ENTRIES));
+	print_result(options, map, grid.width, "idastar", backend, result);
+}
+
+// Answers the whole query list per solve() on a PathThreadPool.
+void run_batch(const Options& options, const char* map, const DenseGridWithWeights& grid,
+	const vector<pair<Location, Location> >& queries) {
+	long long heap_before = heap_bytes;
+	heap_peak = heap_bytes.load();
+	PathThreadPool pool(options.threads);
+	BatchPathfinder<DenseGridWithWeights> batch(grid);
+	vector<BatchPathfinder<DenseGridWithWeights>::Result> results;
+	batch.solve(queries, results, pool);
+	long long allocations_before = allocations;
+
+	Result result = Result();
+	auto begin = std::chrono::steady_clock::now();
+	do {
+		batch.solve(queries, results, pool);
+		for (auto& path : results) {
+			if (path.found) {
+				result.cost += path.cost;
+				++result.found;
+			}
+		}
+		result.queries += queries.size();
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	} while (result.seconds < options.min_time);
+
+	result.allocations = allocations - allocations_before;
+	result.peak_bytes = heap_peak - heap_before;
+	char backend[32];
+	std::snprintf(backend, sizeof(backend), "batch_%dt", pool.workers());
+	print_result(options, map, grid.width, "astar", backend, result);
+}
+
+void run_map(const Options& options, const MapKind& kind, int size) {
+	std::mt19937 rng(options.seed);
+	BenchGrid grid(kind.make(size, rng));
+	int count = size <= 256 ? 32 : 8;
+	auto queries = make_queries(grid, std::strcmp(kind.name, "spiral") == 0, count, rng);
+	if (queries.empty()) {
+		return;
+	}
+	typedef SearchStorage<BenchGrid> Storage;
+
+	Result result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		auto came_from = breadth_first_search(grid, start, goal);
+		if (!came_from.count(goal)) {
+			return false;
+		}
+		cost = int(reconstruct_path(start, goal, came_from).size()) - 1;
+		return true;
+	});
+	print_result(options, kind.name, size, "bfs", "map", result);
+
+	long long heap_base = heap_bytes;
+	SearchWorkspace<BenchGrid> workspace(grid);
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!breadth_first_search(grid, start, goal, workspace)) {
+			return false;
+		}
+		cost = workspace.cost_so_far[grid.index(goal)];
+		return true;
+	}, heap_base);
+	print_result(options, kind.name, size, "bfs", "workspace", result);
+
+	SearchWorkspace<BenchGrid> backward(grid);
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		if (!bidirectional_breadth_first_search(grid, start, goal, workspace, backward)) {
+			return false;
+		}
+		cost = workspace.cost_so_far[grid.index(goal)];
+		return true;
+	}, heap_base);
+	print_result(options, kind.name, size, "bibfs", "workspace", result);
+
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		auto came_from = Storage::make_came_from(grid);
+		auto cost_so_far = Storage::make_cost_so_far(grid);
+		dijkstra_search(grid, start, goal, came_from, cost_so_far);
+		if (!cost_so_far.count(goal)) {
+			return false;
+		}
+		cost = cost_so_far[goal];
+		return true;
+	});
+	print_result(options, kind.name, size, "dijkstra", "map", result);
+
+	result = run(options, grid, queries, [&](Location start, Location goal, int& cost) {
+		auto came_from = Storage::make_came_from(grid);
+		auto cost_so_far = Storage::make_cost_so_far(grid);
+		a_star_search(grid, start, goal, came_from, cost_so_far);
+		if (!cost_so_far.count(goal)) {
+			return false;
+		}
+		cost = cost_so_far[goal];
+		return true;
+	});
+	print_result(options, kind.name, size, "astar", "map", result);
+
+	run_workspace<PriorityQueue<int> >(options, kind.name, grid, queries, "workspace_heap");
+	run_workspace<BucketQueue<int> >(options, kind.name, grid, queries, "workspace_bucket");
+	run_workspace<RadixHeap<int> >(options, kind.name, grid, queries, "workspace_radix");
+	// the depth first passes get slower much faster than the map grows
+	if (size <= 64) {
+		run_ida(options, kind.name, grid, queries);
+	}
+
+	auto batch_queries = make_queries(grid, std::strcmp(kind.name, "spiral") == 0, count * 16, rng);
+	run_batch(options, kind.name, grid, batch_queries);
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		string value = argv[++i];
+		if (arg == "--format") {
+			options.json = value == "json";
+		}
+		else if (arg == "--sizes") {
+			options.sizes.clear();
+			for (size_t begin = 0; begin < value.size();) {
+				size_t end = value.find(',', begin);
+				if (end == string::npos) {
+					end = value.size();
+				}
+				options.sizes.push_back(std::atoi(value.substr(begin, end - begin).c_str()));
+				begin = end + 1;
+			}
+		}
+		else if (arg == "--min-time") {
+			options.min_time = std::atof(value.c_str());
+		}
+		else if (arg == "--seed") {
+			options.seed = unsigned(std::strtoul(value.c_str(), nullptr, 10));
+		}
+		else if (arg == "--threads") {
+			options.threads = std::atoi(value.c_str());
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		std::fprintf(stderr, "usage: %s [--format csv|json] [--sizes 64,256,512] [--min-time seconds] [--seed n] [--threads n]\n", argv[0]);
+		return 1;
+	}
+	const MapKind kinds[] = {
+		{ "open", make_open },
+		{ "random", make_random },
+		{ "maze", make_maze },
+		{ "spiral", make_spiral },
+	};
+	print_header(options);
+	for (int size : options.sizes) {
+		for (auto& kind : kinds) {
+			run_map(options, kind, size);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Several near-optimal routes between two cells, different enough that
+// units spread over them instead of walking in single file. Yen's k
+// shortest paths is exact, but on a grid the runners-up differ from the
+// best route by one cell, so this uses the penalty method instead: after
+// every search each cell on the route found costs more to enter, which
+// pushes the next search onto other cells. A route is kept when its real
+// cost stays within max_stretch of the best one and at most max_overlap of
+// its cells lie on any route kept before.
+//
+// The searches only run here, once per map; the routes come back packed
+// into one array of cell indices, so handing one out costs no search.
+
+// Routes from one start to one goal, start to goal, back to back.
+struct RouteSet {
+	// graph indices of the cells of every route
+	vector<int> cells;
+	// route r is cells[offsets[r]] up to cells[offsets[r + 1]]
+	vector<int> offsets;
+	// real cost of every route, without penalties; costs[0] is the best
+	vector<int> costs;
+
+	RouteSet() : offsets(1, 0) {}
+
+	inline int size() const {
+		return int(offsets.size()) - 1;
+	}
+
+	inline int length(int route) const {
+		return offsets[route + 1] - offsets[route];
+	}
+
+	inline const int* begin(int route) const {
+		return cells.data() + offsets[route];
+	}
+
+	inline const int* end(int route) const {
+		return cells.data() + offsets[route + 1];
+	}
+};
+
+template<typename Graph>
+RouteSet diverse_routes
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+int count,
+double max_stretch = 1.5,
+double max_overlap = 0.7,
+// extra cost, in multiples of the step cost, per route already using a cell
+int penalty = 1)
+{
+	typedef typename Graph::Location Location;
+	// searches allowed per route asked for, as many of them get rejected
+	enum { ATTEMPTS_PER_ROUTE = 4 };
+
+	RouteSet routes;
+	SearchWorkspace<Graph, BucketQueue<int> > workspace(graph);
+	// routes through every cell so far, kept or not
+	vector<int> uses(graph.size(), 0);
+	DenseBitset marked(graph.size());
+	int s = graph.index(start), g = graph.index(goal);
+	vector<int> route;
+
+	for (int attempt = 0; attempt < count * ATTEMPTS_PER_ROUTE && routes.size() < count; ++attempt) {
+		// A* over the penalized costs; those never undercut the real ones,
+		// so the heuristic stays consistent and the bucket queue works
+		workspace.begin();
+		workspace.frontier.put(s, 0);
+		workspace.visit(s, s, 0);
+		while (!workspace.frontier.empty()) {
+			int current = workspace.frontier.get();
+			if (current == g) {
+				break;
+			}
+			Location id = graph.location(current);
+			for_each_edge(graph, id, [&](Location next, int cost) {
+				int n = graph.index(next);
+				int new_cost = workspace.cost_so_far[current] + cost * (1 + penalty * uses[n]);
+				if (!workspace.reached(n) || new_cost < workspace.cost_so_far[n]) {
+					workspace.visit(n, current, new_cost);
+					workspace.frontier.put(n, new_cost + heuristic(graph, next, goal));
+				}
+			});
+		}
+		if (!workspace.reached(g)) {
+			break;
+		}
+
+		route.clear();
+		int real_cost = 0;
+		for (int current = g; current != s; current = workspace.came_from[current]) {
+			route.push_back(current);
+			real_cost += graph.cost(graph.location(workspace.came_from[current]), graph.location(current));
+		}
+		route.push_back(s);
+		std::reverse(route.begin(), route.end());
+
+		// the penalties only grow, so later routes are hardly ever cheaper
+		if (routes.size() > 0 && real_cost > routes.costs[0] * max_stretch) {
+			break;
+		}
+
+		bool distinct = true;
+		for (int cell : route) {
+			marked.set(cell);
+		}
+		for (int r = 0; r < routes.size() && distinct; ++r) {
+			int shared = 0;
+			for (const int* cell = routes.begin(r); cell != routes.end(r); ++cell) {
+				shared += marked.test(*cell) ? 1 : 0;
+			}
+			distinct = shared <= max_overlap * int(route.size());
+		}
+		for (int cell : route) {
+			marked.reset(cell);
+			if (cell != s && cell != g) {
+				++uses[cell];
+			}
+		}
+
+		if (distinct) {
+			routes.cells.insert(routes.cells.end(), route.begin(), route.end());
+			routes.offsets.push_back(int(routes.cells.size()));
+			routes.costs.push_back(real_cost);
+		}
+	}
+	return routes;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Any-angle post-processing for grid paths. A grid search returns one
+// waypoint per cell, so a unit walking it turns at every cell and a long
+// diagonal becomes a staircase. smooth_path() pulls the path tight like a
+// string: from each kept waypoint it skips ahead to the farthest later one
+// still in straight line of sight, so only the corners around walls remain.
+//
+// Cells are unit squares around their integer coordinates, and a segment
+// sees through when every cell it touches is open. Where it passes exactly
+// through the corner of four cells, both cells beside it must be open, so
+// a path never squeezes diagonally between two walls. Step costs are not
+// looked at, so on weighted maps a segment may cut across expensive cells.
+
+// Walks the cells under the segment between the centers of a and b in
+// order (Amanatides and Woo), with integer arithmetic only.
+template<typename Graph>
+bool line_of_sight(const Graph& graph, typename Graph::Location a, typename Graph::Location b) {
+	typedef typename Graph::Location Location;
+	int x, y, x1, y1;
+	tie(x, y) = a;
+	tie(x1, y1) = b;
+	int dx = std::abs(x1 - x), dy = std::abs(y1 - y);
+	int sx = x1 > x ? 1 : -1, sy = y1 > y ? 1 : -1;
+	// > 0 when the segment leaves the current cell sideways next, < 0 when
+	// it leaves through the top or bottom, 0 through the corner
+	int error = dx - dy;
+	dx *= 2;
+	dy *= 2;
+
+	for (int n = (dx + dy) / 2; n > 0; --n) {
+		if (error > 0) {
+			x += sx;
+			error -= dy;
+		}
+		else if (error < 0) {
+			y += sy;
+			error += dx;
+		}
+		else {
+			if (!graph.passable(Location(x + sx, y)) || !graph.passable(Location(x, y + sy))) {
+				return false;
+			}
+			x += sx;
+			y += sy;
+			error += dx - dy;
+			--n;
+		}
+		if (!graph.passable(Location(x, y))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Drops every waypoint the path can go straight past, in place. Works on
+// either order, start to goal or goal to start like reconstruct_path; the
+// first and last waypoints always stay.
+template<typename Graph>
+void smooth_path(const Graph& graph, vector<typename Graph::Location>& path) {
+	if (path.size() < 3) {
+		return;
+	}
+	size_t kept = 0;
+	for (size_t i = 2; i < path.size(); ++i) {
+		if (!line_of_sight(graph, path[kept], path[i])) {
+			path[++kept] = path[i - 1];
+		}
+	}
+	path[++kept] = path.back();
+	path.resize(kept + 1);
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bit-parallel breadth first search for unit cost, 4-connected grids. Walls
+// and the frontier are packed into 64-bit words of 8x8 cells, bit
+// y * 8 + x of a word, like a chess bitboard. A wavefront grows with four
+// shifts and masks per word, and edge bits carry over into the words next
+// to it. Square tiles keep several frontier cells in each word whichever
+// way the wavefront runs; a word per row segment would hold only one or
+// two cells of a diagonal front.
+//
+// Only words on the current frontier are touched, so the thin wavefronts
+// of a maze cost a few words each. The tile grid has a ring of empty words
+// around the map, so the expansion needs no bounds checks.
+struct BitboardBFS {
+	typedef DenseGrid::Location Location;
+
+	int width, height;
+	// tiles per stored tile row, including the two padding tiles
+	int pitch;
+	vector<uint64_t> open;
+	vector<uint64_t> visited;
+	vector<uint64_t> frontier;
+	// bits pushed into each word by the current expansion; all zero between steps
+	vector<uint64_t> next;
+	// words holding frontier bits, and the words next was written to
+	vector<int> active;
+	vector<int> touched;
+
+	explicit BitboardBFS(const DenseGrid& grid)
+		: width(grid.width), height(grid.height), pitch((grid.width + 7) / 8 + 2),
+		open(size_t(pitch) * ((grid.height + 7) / 8 + 2), 0), visited(open.size(), 0),
+		frontier(open.size(), 0), next(open.size(), 0) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				if (grid.walkable.test(y * width + x)) {
+					open[word(x, y)] |= bit(x, y);
+				}
+			}
+		}
+	}
+
+	inline bool passable(Location id) const {
+		return test(open, id);
+	}
+
+	void set_passable(Location id, bool passable_) {
+		int x, y;
+		tie(x, y) = id;
+		if (passable_) {
+			open[word(x, y)] |= bit(x, y);
+		}
+		else {
+			open[word(x, y)] &= ~bit(x, y);
+		}
+	}
+
+	// Reached by the last search.
+	inline bool reached(Location id) const {
+		return test(visited, id);
+	}
+
+	// Cell of bit b in word i of a layer.
+	inline Location location(int i, int b) const {
+		return Location((i % pitch - 1) * 8 + (b & 7), (i / pitch - 1) * 8 + (b >> 3));
+	}
+
+	// Expands wavefronts from sources until none is left or the visitor
+	// returns false. The visitor is called as visit(depth, words, layer) for
+	// every wavefront, starting with the sources at depth 0; words lists the
+	// indices of the layer words that hold bits, see location(). Returns the
+	// number of wavefronts visited.
+	template<typename Visitor>
+	int search(const vector<Location>& sources, Visitor visit) {
+		std::fill(visited.begin(), visited.end(), uint64_t(0));
+		for (int i : active) {
+			frontier[i] = 0;
+		}
+		active.clear();
+		for (auto source : sources) {
+			if (passable(source)) {
+				int x, y;
+				tie(x, y) = source;
+				int i = word(x, y);
+				if (frontier[i] == 0) {
+					active.push_back(i);
+				}
+				frontier[i] |= bit(x, y);
+				visited[i] |= bit(x, y);
+			}
+		}
+
+		int depth = 0;
+		while (!active.empty()) {
+			if (!visit(depth, active, frontier)) {
+				return depth + 1;
+			}
+			++depth;
+			expand();
+		}
+		return depth;
+	}
+
+	// Marks every cell connected to source, see reached().
+	void flood(Location source) {
+		vector<Location> sources(1, source);
+		search(sources, [](int, const vector<int>&, const vector<uint64_t>&) { return true; });
+	}
+
+	// Steps from source to every cell, -1 where it cannot be reached.
+	void distance_field(Location source, vector<int>& distances) {
+		distances.assign(size_t(width) * height, -1);
+		vector<Location> sources(1, source);
+		search(sources, [&](int depth, const vector<int>& words, const vector<uint64_t>& layer) {
+			for (int i : words) {
+				int base = ((i / pitch - 1) * width + (i % pitch - 1)) * 8;
+				for (uint64_t bits = layer[i]; bits != 0; bits &= bits - 1) {
+					int b = lowest_bit(bits);
+					distances[base + (b >> 3) * width + (b & 7)] = depth;
+				}
+			}
+			return true;
+		});
+	}
+
+	// Step count between two cells, -1 when they are not connected.
+	int distance(Location start, Location goal) {
+		int result = -1;
+		vector<Location> sources(1, start);
+		search(sources, [&](int depth, const vector<int>&, const vector<uint64_t>& layer) {
+			if (test(layer, goal)) {
+				result = depth;
+				return false;
+			}
+			return true;
+		});
+		return result;
+	}
+
+private:
+	// columns and rows of a tile
+	static inline uint64_t first_column() { return 0x0101010101010101ULL; }
+	static inline uint64_t last_column() { return 0x8080808080808080ULL; }
+	static inline uint64_t first_row() { return 0x00000000000000ffULL; }
+	static inline uint64_t last_row() { return 0xff00000000000000ULL; }
+
+	inline int word(int x, int y) const {
+		return ((y >> 3) + 1) * pitch + (x >> 3) + 1;
+	}
+
+	static inline uint64_t bit(int x, int y) {
+		return uint64_t(1) << ((y & 7) * 8 + (x & 7));
+	}
+
+	inline bool test(const vector<uint64_t>& bits, Location id) const {
+		int x, y;
+		tie(x, y) = id;
+		return (bits[word(x, y)] & bit(x, y)) != 0;
+	}
+
+	static inline int lowest_bit(uint64_t bits) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return int(index);
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	inline void push(int i, uint64_t bits) {
+		if (bits != 0) {
+			next[i] |= bits;
+			touched.push_back(i);
+		}
+	}
+
+	// Each frontier word grows inside its tile and carries its edge bits
+	// into the tiles around it. A word can be touched several times; the
+	// first visit in the second pass takes its bits and zeroes next for the
+	// others.
+	void expand() {
+		touched.clear();
+		for (int i : active) {
+			uint64_t f = frontier[i];
+			frontier[i] = 0;
+			push(i, ((f << 1) & ~first_column()) | ((f >> 1) & ~last_column()) | (f << 8) | (f >> 8));
+			push(i + 1, (f & last_column()) >> 7);
+			push(i - 1, (f & first_column()) << 7);
+			push(i + pitch, (f & last_row()) >> 56);
+			push(i - pitch, (f & first_row()) << 56);
+		}
+
+		active.clear();
+		for (int i : touched) {
+			uint64_t bits = next[i] & open[i] & ~visited[i];
+			next[i] = 0;
+			if (bits != 0) {
+				frontier[i] = bits;
+				visited[i] |= bits;
+				active.push_back(i);
+			}
+		}
+	}
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Answers "would a wall on this cell cut a source off the goal?" for every
+// cell at once. A depth first search from the goal finds the articulation
+// points of the open cells (Tarjan's low links): a cell v cuts off the
+// subtree below its child c when no cell in that subtree has an edge
+// climbing above v, i.e. low[c] >= disc[v]. Counting the sources in every
+// subtree on the way back up keeps only the cuts that strand a source, so
+// after one linear pass blocks() is a single bit test, cheap enough to ask
+// for every cell under the mouse each frame.
+//
+// The goal and the sources themselves always block. Cells that are already
+// walls or cannot reach the goal never do. The search treats every edge as
+// two-way, which holds for all the grids.
+//
+// Editing the map only sets stale; the table is rebuilt by the next
+// blocks() that needs it, so a run of edits costs one pass at most. Most
+// asks need none: on 4-connected grids a cell whose open neighbors all
+// reach each other through the eight cells around it cuts nothing off, and
+// that is told from the ring alone. Only cells that may be a narrow pass,
+// asked after an edit, pay for the linear pass.
+template<typename Graph>
+struct BlockingOracle {
+	typedef typename Graph::Location Location;
+
+	const Graph& graph;
+	Location goal;
+	vector<Location> sources;
+	// cells whose wall would strand a source
+	DenseBitset cuts;
+	// set after editing the map, until cuts is rebuilt
+	bool stale;
+
+	BlockingOracle(const Graph& graph_, Location goal_, const vector<Location>& sources_)
+		: graph(graph_), goal(goal_), sources(sources_) {
+		rebuild();
+	}
+
+	bool blocks(Location id) {
+		if (stale) {
+			if (id != goal && std::find(sources.begin(), sources.end(), id) == sources.end() && bypassed(id)) {
+				return false;
+			}
+			rebuild();
+		}
+		return cuts.test(graph.index(id));
+	}
+
+	// Recomputes the table for the current map.
+	void rebuild() {
+		stale = false;
+		cuts = DenseBitset(graph.size());
+		disc.assign(graph.size(), -1);
+		low.resize(graph.size());
+		below.assign(graph.size(), 0);
+		for (auto source : sources) {
+			below[graph.index(source)] = 1;
+		}
+
+		int time = 0;
+		discover(graph.index(goal), -1, time);
+		while (!frames.empty()) {
+			Frame frame = frames.back();
+			if (int(edges.size()) > frame.edges) {
+				int n = edges.back();
+				edges.pop_back();
+				if (disc[n] < 0) {
+					discover(n, frame.cell, time);
+				}
+				else if (n != frame.parent) {
+					low[frame.cell] = std::min(low[frame.cell], disc[n]);
+				}
+				continue;
+			}
+
+			frames.pop_back();
+			int v = frame.cell, p = frame.parent;
+			if (p >= 0) {
+				low[p] = std::min(low[p], low[v]);
+				below[p] += below[v];
+				if (low[v] >= disc[p] && below[v] > 0) {
+					cuts.set(p);
+				}
+			}
+		}
+
+		cuts.set(graph.index(goal));
+		for (auto source : sources) {
+			cuts.set(graph.index(source));
+		}
+	}
+
+private:
+	// Whether the open 4-neighbors of id all reach each other around it,
+	// through one unbroken arc of the eight cells of its ring.
+	bool bypassed(Location id) const {
+		if (Graph::MAX_NEIGHBORS != 4) {
+			return false;
+		}
+		// clockwise from north; the even ones are the neighbors
+		static const int RING[8][2] = { { 0, -1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 } };
+		int x, y;
+		tie(x, y) = id;
+		bool open[8];
+		for (int i = 0; i < 8; ++i) {
+			Location cell(x + RING[i][0], y + RING[i][1]);
+			open[i] = graph.in_bounds(cell) && graph.passable(cell);
+		}
+		int arcs = 0;
+		for (int i = 0; i < 8; ++i) {
+			if (!open[i] || open[(i + 7) % 8]) {
+				continue;
+			}
+			// an arc starts here; count it if it holds a neighbor
+			bool neighbor = false;
+			for (int j = i; open[j % 8] && j < i + 8; ++j) {
+				neighbor = neighbor || j % 2 == 0;
+			}
+			arcs += neighbor ? 1 : 0;
+		}
+		// a fully open ring has no start and is one arc
+		return arcs <= 1;
+	}
+
+	struct Frame {
+		int cell, parent;
+		// size of edges when the cell was entered; the cell's own edges
+		// are the ones above it
+		int edges;
+	};
+
+	// discovery time, -1 until reached
+	vector<int> disc;
+	// lowest discovery time reachable from the subtree by one back edge
+	vector<int> low;
+	// sources in the subtree
+	vector<int> below;
+	// the recursion as an explicit stack, so large open maps cannot
+	// overflow the call stack
+	vector<Frame> frames;
+	vector<int> edges;
+
+	void discover(int cell, int parent, int& time) {
+		disc[cell] = low[cell] = time++;
+		Frame frame = { cell, parent, int(edges.size()) };
+		frames.push_back(frame);
+		graph.for_each_neighbor(graph.location(cell), [&](Location next) {
+			edges.push_back(graph.index(next));
+		});
+	}
+};
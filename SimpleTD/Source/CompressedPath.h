@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#include <cstdint>
+
+// A 4-connected grid path stored as its start cell and run-length encoded
+// steps, one byte per straight run of up to MAX_RUN cells: the index into
+// SquareGrid::DIRS in the low two bits, the run length minus one in the
+// rest. A path that turns every few cells takes a byte per turn instead of
+// a position per cell, so many routes fit in a few cache lines.
+//
+// PathCursor walks a path forwards without unpacking it, a cell or a whole
+// straight run at a time, so a unit only keeps the cursor and the shared
+// bytes.
+struct CompressedPath {
+	typedef tuple<int, int> Location;
+	enum { MAX_RUN = 64 };
+
+	Location start;
+	// steps from start to the end
+	int length;
+	vector<uint8_t> runs;
+
+	CompressedPath() : start(0, 0), length(0) {}
+
+	// Packs cells, each a 4-neighbor of the one before, e.g. a search's
+	// path after reversing it.
+	template<typename Iterator>
+	void assign(Iterator first, Iterator last) {
+		runs.clear();
+		length = 0;
+		if (first == last) {
+			return;
+		}
+		start = Location(*first);
+		int x, y;
+		tie(x, y) = start;
+		for (++first; first != last; ++first) {
+			int nx, ny;
+			tie(nx, ny) = *first;
+			int direction = direction_code(nx - x, ny - y);
+			if (!runs.empty() && (runs.back() & 3) == direction && (runs.back() >> 2) + 1 < MAX_RUN) {
+				runs.back() += 4;
+			}
+			else {
+				runs.push_back(uint8_t(direction));
+			}
+			x = nx;
+			y = ny;
+			++length;
+		}
+	}
+
+	// Last cell of the path.
+	Location end() const {
+		int x, y, dx, dy;
+		tie(x, y) = start;
+		for (uint8_t run : runs) {
+			tie(dx, dy) = SquareGrid::DIRS[run & 3];
+			x += dx * ((run >> 2) + 1);
+			y += dy * ((run >> 2) + 1);
+		}
+		return Location(x, y);
+	}
+
+	inline size_t bytes() const {
+		return sizeof(*this) + runs.capacity();
+	}
+};
+
+struct PathCursor {
+	typedef CompressedPath::Location Location;
+
+	const CompressedPath* path;
+	// current run, and steps left in it
+	size_t run;
+	int left;
+	Location at;
+
+	PathCursor() : path(nullptr), run(0), left(0), at(0, 0) {}
+
+	explicit PathCursor(const CompressedPath& path_)
+		: path(&path_), run(0), left(path_.runs.empty() ? 0 : (path_.runs[0] >> 2) + 1), at(path_.start) {}
+
+	inline bool done() const {
+		return !path || run >= path->runs.size();
+	}
+
+	// One cell ahead. False at the end of the path.
+	bool step() {
+		return advance(1) == 1;
+	}
+
+	// To the end of the straight line ahead, also across runs split at
+	// MAX_RUN. Returns the steps taken, 0 at the end of the path.
+	int skip_run() {
+		if (done()) {
+			return 0;
+		}
+		int direction = path->runs[run] & 3;
+		int steps = 0;
+		while (!done() && (path->runs[run] & 3) == direction) {
+			steps += advance(left);
+		}
+		return steps;
+	}
+
+private:
+	// Up to steps cells along the current run.
+	int advance(int steps) {
+		if (done()) {
+			return 0;
+		}
+		steps = std::min(steps, left);
+		int x, y, dx, dy;
+		tie(x, y) = at;
+		tie(dx, dy) = SquareGrid::DIRS[path->runs[run] & 3];
+		at = Location(x + dx * steps, y + dy * steps);
+		left -= steps;
+		if (left == 0 && ++run < path->runs.size()) {
+			left = (path->runs[run] >> 2) + 1;
+		}
+		return steps;
+	}
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#include <cstdint>
+
+// Connected component labels of the walkable cells, so a search between
+// two cells that cannot reach each other is turned down up front instead
+// of flooding everything reachable from the start first.
+//
+// Every walkable cell carries a component id, and ids that were merged
+// share a root in a union-find, so connected() is two array lookups and a
+// couple of parent hops. Opening a cell only unites the components around
+// it. Closing a cell may split its component; breadth first searches from
+// its neighbors run in lockstep, one cell each in turn, and stop as soon
+// as every search but one has met another or run out of cells. The pieces
+// that ran out get new ids, so the work is bounded by the smaller pieces
+// and walling off a corner never relabels the rest of the map.
+//
+// The labels follow the graph only through wall_added() and wall_removed(),
+// called after the change. Assumes symmetric edges, as on DenseGrid.
+template<typename Graph>
+struct ComponentLabels {
+	typedef typename Graph::Location Location;
+
+	const Graph& graph;
+
+	explicit ComponentLabels(const Graph& graph_)
+		: graph(graph_), seen(graph_.size(), 0), owner(graph_.size()), generation(0) {
+		build();
+	}
+
+	// Labels every cell from scratch.
+	void build() {
+		label.assign(graph.size(), -1);
+		parent.clear();
+		rank.clear();
+		vector<int>& queue = flood;
+		for (int cell = 0; cell < graph.size(); ++cell) {
+			if (label[cell] >= 0 || !graph.passable(graph.location(cell))) {
+				continue;
+			}
+			int id = new_component();
+			label[cell] = id;
+			queue.assign(1, cell);
+			for (size_t i = 0; i < queue.size(); ++i) {
+				graph.for_each_neighbor(graph.location(queue[i]), [&](Location next) {
+					int n = graph.index(next);
+					if (label[n] < 0) {
+						label[n] = id;
+						queue.push_back(n);
+					}
+				});
+			}
+		}
+	}
+
+	// Root id of the component of id, -1 on walls.
+	int component(Location id) {
+		int cell = graph.index(id);
+		return label[cell] >= 0 ? find(label[cell]) : -1;
+	}
+
+	bool connected(Location a, Location b) {
+		int component_a = component(a);
+		return component_a >= 0 && component_a == component(b);
+	}
+
+	void wall_removed(Location id) {
+		int cell = graph.index(id);
+		if (label[cell] >= 0) {
+			return;
+		}
+		graph.for_each_neighbor(id, [&](Location next) {
+			int n = find(label[graph.index(next)]);
+			label[cell] = label[cell] < 0 ? n : unite(label[cell], n);
+		});
+		if (label[cell] < 0) {
+			label[cell] = new_component();
+		}
+	}
+
+	void wall_added(Location id) {
+		int cell = graph.index(id);
+		if (label[cell] < 0) {
+			return;
+		}
+		label[cell] = -1;
+		// ids are never reused, so relabel before they outnumber the cells
+		if (parent.size() > 2 * size_t(graph.size())) {
+			build();
+			return;
+		}
+
+		searches.clear();
+		begin();
+		graph.for_each_neighbor(id, [&](Location next) {
+			Search search;
+			search.cells.assign(1, graph.index(next));
+			search.head = 0;
+			search.group = int(searches.size());
+			visit(search.cells[0], search.group);
+			searches.push_back(search);
+		});
+		int count = int(searches.size());
+		if (count < 2) {
+			return;
+		}
+
+		int groups, open;
+		for (;;) {
+			// groups of searches that met, and groups still growing
+			groups = open = 0;
+			for (int i = 0; i < count; ++i) {
+				if (group_of(i) == i) {
+					++groups;
+					open += group_open(i) ? 1 : 0;
+				}
+			}
+			if (groups == 1 || open <= 1) {
+				break;
+			}
+			for (int i = 0; i < count; ++i) {
+				Search& search = searches[i];
+				if (search.head == search.cells.size()) {
+					continue;
+				}
+				int current = search.cells[search.head++];
+				graph.for_each_neighbor(graph.location(current), [&](Location next) {
+					int n = graph.index(next);
+					if (seen[n] != generation) {
+						visit(n, i);
+						search.cells.push_back(n);
+						return;
+					}
+					int a = group_of(i), b = group_of(owner[n]);
+					if (a != b) {
+						searches[b].group = a;
+					}
+				});
+			}
+		}
+		if (groups == 1) {
+			return;
+		}
+
+		// the piece still growing, or else the largest, keeps the old id
+		int kept = -1;
+		for (int i = 0; i < count; ++i) {
+			if (group_of(i) != i) {
+				continue;
+			}
+			if (kept < 0 || (open > 0 ? group_open(i) : group_size(i) > group_size(kept))) {
+				kept = i;
+			}
+		}
+		for (int i = 0; i < count; ++i) {
+			if (group_of(i) != i || i == kept) {
+				continue;
+			}
+			int id = new_component();
+			for (int j = 0; j < count; ++j) {
+				if (group_of(j) == i) {
+					for (int n : searches[j].cells) {
+						label[n] = id;
+					}
+				}
+			}
+		}
+	}
+
+private:
+	struct Search {
+		// every cell reached, in breadth first order; cells[head...] are
+		// still to expand
+		vector<int> cells;
+		size_t head;
+		// search this one merged into, itself while it leads its group
+		int group;
+	};
+
+	// component id per cell, -1 on walls
+	vector<int> label;
+	// union-find over component ids
+	vector<int> parent;
+	vector<uint8_t> rank;
+
+	vector<Search> searches;
+	// search that reached each cell, valid where seen is the generation
+	vector<unsigned> seen;
+	vector<int> owner;
+	unsigned generation;
+	// breadth first queue of build()
+	vector<int> flood;
+
+	int new_component() {
+		parent.push_back(int(parent.size()));
+		rank.push_back(0);
+		return int(parent.size()) - 1;
+	}
+
+	int find(int id) {
+		while (parent[id] != id) {
+			parent[id] = parent[parent[id]];
+			id = parent[id];
+		}
+		return id;
+	}
+
+	int unite(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b) {
+			return a;
+		}
+		if (rank[a] < rank[b]) {
+			std::swap(a, b);
+		}
+		parent[b] = a;
+		if (rank[a] == rank[b]) {
+			++rank[a];
+		}
+		return a;
+	}
+
+	void begin() {
+		if (++generation == 0) {
+			std::fill(seen.begin(), seen.end(), 0);
+			generation = 1;
+		}
+	}
+
+	inline void visit(int cell, int search) {
+		seen[cell] = generation;
+		owner[cell] = search;
+	}
+
+	int group_of(int search) const {
+		while (searches[search].group != search) {
+			search = searches[search].group;
+		}
+		return search;
+	}
+
+	bool group_open(int group) const {
+		for (size_t i = 0; i < searches.size(); ++i) {
+			if (group_of(int(i)) == group && searches[i].head < searches[i].cells.size()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t group_size(int group) const {
+		size_t size = 0;
+		for (size_t i = 0; i < searches.size(); ++i) {
+			if (group_of(int(i)) == group) {
+				size += searches[i].cells.size();
+			}
+		}
+		return size;
+	}
+};
@@ -0,0 +1,519 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Contraction hierarchy for graphs whose topology stays fixed for a whole
+// match. build() contracts the nodes of a CSRGraph one by one, least
+// important first, and adds a shortcut u -> x wherever removing v would
+// break the only shortest path u -> v -> x. A query then runs Dijkstra
+// from both ends, only ever moving up to more important nodes, which
+// settles a few hundred nodes where a plain dijkstra_search settles most
+// of the map. Paths have the same cost as dijkstra_search.
+//
+// Ids are those of the CSRGraph. save() and load() keep the preprocessing
+// between runs; load() refuses data built from a different graph, so a
+// stale cache file only costs a rebuild.
+template<typename L>
+struct ContractionHierarchy {
+	typedef int Location;
+	enum { INF = INT_MAX / 2 };
+
+	// Edges kept after contraction, grouped per node like CSRGraph. A
+	// middle of -1 marks an original edge, otherwise the node the shortcut
+	// bypasses.
+	struct Arcs {
+		vector<int> offsets;
+		vector<int> targets;
+		vector<int> weights;
+		vector<int> middles;
+	};
+
+	int node_count;
+	uint64_t fingerprint;
+	vector<int> rank;
+	// arcs u -> x stored at u, with rank[x] > rank[u]
+	Arcs forward;
+	// arcs u -> x stored at x with u as target, with rank[u] > rank[x]
+	Arcs backward;
+	// nodes settled by the last query
+	int settled;
+
+	ContractionHierarchy() : node_count(0), fingerprint(0), settled(0), generation(0) {}
+
+	explicit ContractionHierarchy(const CSRGraph<L>& graph)
+		: node_count(0), fingerprint(0), settled(0), generation(0) {
+		build(graph);
+	}
+
+	static uint64_t fingerprint_of(const CSRGraph<L>& graph) {
+		uint64_t hash = 14695981039346656037ULL;
+		auto mix = [&hash](const vector<int>& values) {
+			for (int value : values) {
+				hash = (hash ^ uint32_t(value)) * 1099511628211ULL;
+			}
+			hash = (hash ^ values.size()) * 1099511628211ULL;
+		};
+		mix(graph.offsets);
+		mix(graph.targets);
+		mix(graph.weights);
+		return hash;
+	}
+
+	void build(const CSRGraph<L>& graph) {
+		node_count = graph.size();
+		fingerprint = fingerprint_of(graph);
+		Contraction contraction(graph);
+		contraction.run(rank, forward, backward);
+		reset_scratch();
+	}
+
+	// Cost of the cheapest path, or -1 when goal cannot be reached. The
+	// path, if asked for, is in the goal-to-start order of reconstruct_path.
+	int query(Location start, Location goal, vector<Location>* path = nullptr) {
+		settled = 0;
+		if (++generation == 0) {
+			std::fill(visited[0].begin(), visited[0].end(), 0);
+			std::fill(visited[1].begin(), visited[1].end(), 0);
+			generation = 1;
+		}
+		for (int side = 0; side < 2; ++side) {
+			while (!frontier[side].empty()) {
+				frontier[side].pop();
+			}
+			int root = side == 0 ? start : goal;
+			reach(side, root, 0, root, -1);
+		}
+
+		int best = INF, meet = -1;
+		for (;;) {
+			int top0 = frontier[0].empty() ? INF : frontier[0].top().first;
+			int top1 = frontier[1].empty() ? INF : frontier[1].top().first;
+			if (std::min(top0, top1) >= best) {
+				break;
+			}
+			int side = top0 <= top1 ? 0 : 1;
+			int d = frontier[side].top().first, n = frontier[side].top().second;
+			frontier[side].pop();
+			if (d > distance[side][n]) {
+				continue;
+			}
+			++settled;
+			if (reached(1 - side, n) && d + distance[1 - side][n] < best) {
+				best = d + distance[1 - side][n];
+				meet = n;
+			}
+			const Arcs& arcs = side == 0 ? forward : backward;
+			for (int a = arcs.offsets[n]; a < arcs.offsets[n + 1]; ++a) {
+				int next = arcs.targets[a];
+				int new_cost = d + arcs.weights[a];
+				if (!reached(side, next) || new_cost < distance[side][next]) {
+					reach(side, next, new_cost, n, a);
+				}
+			}
+		}
+		if (meet < 0) {
+			return -1;
+		}
+		if (path) {
+			unpack_path(start, goal, meet, *path);
+		}
+		return best;
+	}
+
+	bool save(std::ostream& out) const {
+		out.write(MAGIC, 4);
+		write_value(out, node_count);
+		write_value(out, fingerprint);
+		write_vector(out, rank);
+		for (const Arcs* arcs : { &forward, &backward }) {
+			write_vector(out, arcs->offsets);
+			write_vector(out, arcs->targets);
+			write_vector(out, arcs->weights);
+			write_vector(out, arcs->middles);
+		}
+		return bool(out);
+	}
+
+	// False, leaving the hierarchy empty, when the data is damaged or was
+	// built from another graph.
+	bool load(std::istream& in, const CSRGraph<L>& graph) {
+		char magic[4];
+		bool ok = bool(in.read(magic, 4)) && std::equal(magic, magic + 4, MAGIC) &&
+			read_value(in, node_count) && read_value(in, fingerprint) &&
+			node_count == graph.size() && fingerprint == fingerprint_of(graph) &&
+			read_vector(in, rank, node_count);
+		for (Arcs* arcs : { &forward, &backward }) {
+			ok = ok && read_vector(in, arcs->offsets, node_count + 1) &&
+				arcs->offsets.front() == 0 && arcs->offsets.back() >= 0 &&
+				read_vector(in, arcs->targets, arcs->offsets.back()) &&
+				read_vector(in, arcs->weights, arcs->offsets.back()) &&
+				read_vector(in, arcs->middles, arcs->offsets.back());
+		}
+		if (!ok || !valid()) {
+			*this = ContractionHierarchy();
+			return false;
+		}
+		reset_scratch();
+		return true;
+	}
+
+private:
+	typedef pair<int, int> PQElement;
+	typedef priority_queue<PQElement, vector<PQElement>, std::greater<PQElement> > Frontier;
+	static const char MAGIC[4];
+
+	// query scratch, one set per direction
+	vector<int> distance[2];
+	vector<int> parent[2];
+	vector<int> parent_arc[2];
+	vector<unsigned> visited[2];
+	unsigned generation;
+	Frontier frontier[2];
+
+	void reset_scratch() {
+		for (int side = 0; side < 2; ++side) {
+			distance[side].assign(node_count, INF);
+			parent[side].assign(node_count, -1);
+			parent_arc[side].assign(node_count, -1);
+			visited[side].assign(node_count, 0);
+		}
+		generation = 0;
+	}
+
+	inline bool reached(int side, int n) const {
+		return visited[side][n] == generation;
+	}
+
+	inline void reach(int side, int n, int cost, int from, int arc) {
+		visited[side][n] = generation;
+		distance[side][n] = cost;
+		parent[side][n] = from;
+		parent_arc[side][n] = arc;
+		frontier[side].emplace(cost, n);
+	}
+
+	// Index of the cheapest arc at node at whose target is other.
+	static int find_arc(const Arcs& arcs, int at, int other) {
+		int found = -1;
+		for (int a = arcs.offsets[at]; a < arcs.offsets[at + 1]; ++a) {
+			if (arcs.targets[a] == other && (found < 0 || arcs.weights[a] < arcs.weights[found])) {
+				found = a;
+			}
+		}
+		return found;
+	}
+
+	// Whether loaded data keeps query() and unpack() inside the arrays:
+	// every id in range, every arc stored at its lower ranked end, and every
+	// shortcut made of two arcs that exist around a node ranked below both
+	// ends, so unpacking always terminates.
+	bool valid() const {
+		for (int r : rank) {
+			if (r < 0 || r >= node_count) {
+				return false;
+			}
+		}
+		for (const Arcs* arcs : { &forward, &backward }) {
+			for (int at = 0; at < node_count; ++at) {
+				if (arcs->offsets[at] > arcs->offsets[at + 1]) {
+					return false;
+				}
+			}
+			for (size_t a = 0; a < arcs->targets.size(); ++a) {
+				if (arcs->targets[a] < 0 || arcs->targets[a] >= node_count || arcs->weights[a] < 0 ||
+					arcs->middles[a] < -1 || arcs->middles[a] >= node_count) {
+					return false;
+				}
+			}
+		}
+		for (int side = 0; side < 2; ++side) {
+			const Arcs& arcs = side == 0 ? forward : backward;
+			for (int at = 0; at < node_count; ++at) {
+				for (int a = arcs.offsets[at]; a < arcs.offsets[at + 1]; ++a) {
+					int other = arcs.targets[a], m = arcs.middles[a];
+					if (rank[other] <= rank[at]) {
+						return false;
+					}
+					if (m < 0) {
+						continue;
+					}
+					// forward holds from -> to at from, backward at to
+					int from = side == 0 ? at : other, to = side == 0 ? other : at;
+					if (rank[m] >= rank[at] || find_arc(forward, m, to) < 0 || find_arc(backward, m, from) < 0) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Appends the nodes after a up to and including b. A shortcut a -> b
+	// around m stands for the arc a -> m, kept at m in backward because m
+	// ranks below a, followed by m -> b, kept at m in forward.
+	void unpack(int a, int b, int middle, vector<int>& out) const {
+		vector<tuple<int, int, int> > stack(1, tuple<int, int, int>(a, b, middle));
+		while (!stack.empty()) {
+			int from, to, m;
+			tie(from, to, m) = stack.back();
+			stack.pop_back();
+			if (m < 0) {
+				out.push_back(to);
+				continue;
+			}
+			int second = find_arc(forward, m, to);
+			int first = find_arc(backward, m, from);
+			stack.emplace_back(m, to, forward.middles[second]);
+			stack.emplace_back(from, m, backward.middles[first]);
+		}
+	}
+
+	void unpack_path(int start, int goal, int meet, vector<int>& path) const {
+		vector<int> up;
+		for (int n = meet; n != start; n = parent[0][n]) {
+			up.push_back(n);
+		}
+		vector<int> nodes(1, start);
+		for (auto n = up.rbegin(); n != up.rend(); ++n) {
+			unpack(parent[0][*n], *n, forward.middles[parent_arc[0][*n]], nodes);
+		}
+		for (int n = meet; n != goal; n = parent[1][n]) {
+			unpack(n, parent[1][n], backward.middles[parent_arc[1][n]], nodes);
+		}
+		path.assign(nodes.rbegin(), nodes.rend());
+	}
+
+	template<typename T>
+	static void write_value(std::ostream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void write_vector(std::ostream& out, const vector<int>& values) {
+		write_value(out, int(values.size()));
+		if (!values.empty()) {
+			out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int));
+		}
+	}
+
+	template<typename T>
+	static bool read_value(std::istream& in, T& value) {
+		return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	// Reads a vector of the expected size. Grows with the data actually read,
+	// so a damaged size runs into the end of the stream rather than into a
+	// huge allocation.
+	static bool read_vector(std::istream& in, vector<int>& values, int expected) {
+		int size;
+		if (!read_value(in, size) || size != expected) {
+			return false;
+		}
+		values.clear();
+		const size_t CHUNK = 1 << 16;
+		while (values.size() < size_t(size)) {
+			size_t done = values.size();
+			values.resize(std::min(size_t(size), done + CHUNK));
+			if (!in.read(reinterpret_cast<char*>(values.data() + done), (values.size() - done) * sizeof(int))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Preprocessing state, dropped once the hierarchy is built.
+	struct Contraction {
+		struct Edge {
+			int node;
+			int weight;
+			int middle;
+		};
+
+		int size;
+		vector<vector<Edge> > out;
+		vector<vector<Edge> > in;
+		vector<bool> contracted;
+		vector<int> contracted_neighbors;
+		// witness search scratch
+		vector<int> distance;
+		vector<unsigned> visited;
+		unsigned generation;
+		Frontier frontier;
+
+		explicit Contraction(const CSRGraph<L>& graph)
+			: size(graph.size()), out(size), in(size), contracted(size, false), contracted_neighbors(size, 0),
+			distance(size, INF), visited(size, 0), generation(0) {
+			for (int u = 0; u < size; ++u) {
+				for_each_edge(graph, u, [&](int x, int weight) {
+					if (x != u) {
+						add_edge(u, x, weight, -1);
+					}
+				});
+			}
+		}
+
+		void run(vector<int>& rank, Arcs& forward, Arcs& backward) {
+			rank.assign(size, 0);
+			vector<vector<Edge> > up(size), down(size);
+			Frontier order;
+			for (int v = 0; v < size; ++v) {
+				order.emplace(priority(v), v);
+			}
+			int next_rank = 0;
+			while (!order.empty()) {
+				int v = order.top().second;
+				order.pop();
+				// lazy update: priorities go stale as the neighbors get contracted
+				int current = priority(v);
+				if (!order.empty() && current > order.top().first) {
+					order.emplace(current, v);
+					continue;
+				}
+				for (auto& edge : out[v]) {
+					if (!contracted[edge.node]) {
+						up[v].push_back(edge);
+						++contracted_neighbors[edge.node];
+					}
+				}
+				for (auto& edge : in[v]) {
+					if (!contracted[edge.node]) {
+						down[v].push_back(edge);
+						++contracted_neighbors[edge.node];
+					}
+				}
+				contract(v, false);
+				contracted[v] = true;
+				rank[v] = next_rank++;
+			}
+			pack(up, forward);
+			pack(down, backward);
+		}
+
+	private:
+		void add_edge(int u, int x, int weight, int middle) {
+			for (auto& edge : out[u]) {
+				if (edge.node == x) {
+					if (weight < edge.weight) {
+						edge.weight = weight;
+						edge.middle = middle;
+						for (auto& back : in[x]) {
+							if (back.node == u) {
+								back.weight = weight;
+								back.middle = middle;
+							}
+						}
+					}
+					return;
+				}
+			}
+			Edge forward_edge = { x, weight, middle };
+			Edge backward_edge = { u, weight, middle };
+			out[u].push_back(forward_edge);
+			in[x].push_back(backward_edge);
+		}
+
+		// Shortcuts needed minus edges removed, plus a term that spreads
+		// the contraction evenly over the map.
+		int priority(int v) {
+			int edges = 0;
+			for (auto& edge : out[v]) {
+				edges += contracted[edge.node] ? 0 : 1;
+			}
+			for (auto& edge : in[v]) {
+				edges += contracted[edge.node] ? 0 : 1;
+			}
+			return contract(v, true) - edges + contracted_neighbors[v];
+		}
+
+		// Adds, or with simulate only counts, the shortcuts for removing v.
+		int contract(int v, bool simulate) {
+			int shortcuts = 0;
+			for (size_t i = 0; i < in[v].size(); ++i) {
+				Edge incoming = in[v][i];
+				int u = incoming.node;
+				if (contracted[u]) {
+					continue;
+				}
+				int limit = 0;
+				for (auto& outgoing : out[v]) {
+					if (!contracted[outgoing.node] && outgoing.node != u) {
+						limit = std::max(limit, incoming.weight + outgoing.weight);
+					}
+				}
+				witness_search(u, v, limit, simulate ? 20 : 100);
+				for (size_t j = 0; j < out[v].size(); ++j) {
+					Edge outgoing = out[v][j];
+					int x = outgoing.node;
+					if (contracted[x] || x == u) {
+						continue;
+					}
+					int via = incoming.weight + outgoing.weight;
+					if (visited[x] == generation && distance[x] <= via) {
+						continue;
+					}
+					++shortcuts;
+					if (!simulate) {
+						add_edge(u, x, via, v);
+					}
+				}
+			}
+			return shortcuts;
+		}
+
+		// Dijkstra from source around v, up to limit and max_settled nodes.
+		// Stopping early only costs an unneeded shortcut, never a wrong one,
+		// so the estimates for the node order get by with a short search.
+		void witness_search(int source, int v, int limit, int max_settled) {
+			if (++generation == 0) {
+				std::fill(visited.begin(), visited.end(), 0);
+				generation = 1;
+			}
+			while (!frontier.empty()) {
+				frontier.pop();
+			}
+			visited[source] = generation;
+			distance[source] = 0;
+			frontier.emplace(0, source);
+			int settled = 0;
+			while (!frontier.empty() && settled < max_settled) {
+				int d = frontier.top().first, n = frontier.top().second;
+				frontier.pop();
+				if (d > distance[n]) {
+					continue;
+				}
+				if (d > limit) {
+					break;
+				}
+				++settled;
+				for (auto& edge : out[n]) {
+					if (contracted[edge.node] || edge.node == v) {
+						continue;
+					}
+					int new_cost = d + edge.weight;
+					if (visited[edge.node] != generation || new_cost < distance[edge.node]) {
+						visited[edge.node] = generation;
+						distance[edge.node] = new_cost;
+						frontier.emplace(new_cost, edge.node);
+					}
+				}
+			}
+		}
+
+		static void pack(const vector<vector<Edge> >& lists, Arcs& arcs) {
+			arcs.offsets.assign(1, 0);
+			arcs.targets.clear();
+			arcs.weights.clear();
+			arcs.middles.clear();
+			for (auto& list : lists) {
+				for (auto& edge : list) {
+					arcs.targets.push_back(edge.node);
+					arcs.weights.push_back(edge.weight);
+					arcs.middles.push_back(edge.middle);
+				}
+				arcs.offsets.push_back(int(arcs.targets.size()));
+			}
+		}
+	};
+};
+
+template<typename L>
+const char ContractionHierarchy<L>::MAGIC[4] = { 'C', 'H', '0', '1' };
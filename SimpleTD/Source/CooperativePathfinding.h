@@ -0,0 +1,262 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#include <cstdint>
+
+// Windowed cooperative A* (WHCA*, Silver 2005) for many agents heading to
+// one goal. Time runs in ticks and every agent moves to a neighbor or waits
+// once per tick. A space-time reservation table records which agent holds
+// which cell at which tick, and each agent plans only the next window ticks
+// around the reservations of the others, so no two agents share a cell or
+// swap places inside the window.
+//
+// The search beyond the window is replaced by the exact step distance to
+// the goal, one reverse breadth first search shared by all agents, which
+// makes the windowed search optimal for its window and cheap. Step costs
+// are not used: a move takes one tick on every cell.
+//
+// Agents replan every window / 2 ticks, each in a different tick, so the
+// search cost per tick stays near agents / (window / 2) searches however
+// many agents start or stop at once. Agents leave when they reach the goal,
+// which holds any number of them.
+template<typename Graph>
+struct CooperativePlanner {
+	typedef typename Graph::Location Location;
+	enum { INF = INT_MAX / 2 };
+
+	const Graph& graph;
+	Location goal;
+	// ticks planned ahead per search
+	int window;
+	// current tick
+	int time;
+
+	CooperativePlanner(const Graph& graph_, Location goal_, int window_ = 16)
+		: graph(graph_), goal(goal_), window(std::max(window_, 2)), time(0),
+		parked(graph_.size(), -1), generation(0) {
+		rebuild();
+	}
+
+	// Recomputes the distances to the goal after the map changed. Plans made
+	// before are kept until their agents replan.
+	void rebuild() {
+		distance.assign(graph.size(), INF);
+		vector<int> queue(1, graph.index(goal));
+		distance[queue[0]] = 0;
+		for (size_t i = 0; i < queue.size(); ++i) {
+			int current = queue[i];
+			graph.for_each_neighbor(graph.location(current), [&](Location next) {
+				int n = graph.index(next);
+				if (distance[n] == INF) {
+					distance[n] = distance[current] + 1;
+					queue.push_back(n);
+				}
+			});
+		}
+	}
+
+	// Adds an agent standing on start; it plans on the next step().
+	int add_agent(Location start) {
+		Agent agent;
+		agent.cell = graph.index(start);
+		agent.plan_start = time;
+		agent.active = agent.cell != graph.index(goal);
+		agents.push_back(agent);
+		if (agent.active) {
+			park(int(agents.size()) - 1);
+		}
+		return int(agents.size()) - 1;
+	}
+
+	void remove_agent(int id) {
+		release(id);
+		agents[id].active = false;
+	}
+
+	inline Location position(int id) const {
+		return graph.location(agents[id].cell);
+	}
+
+	// Whether the agent reached the goal or was removed.
+	inline bool arrived(int id) const {
+		return !agents[id].active;
+	}
+
+	// Replans the agents due this tick, then moves every agent one tick.
+	void step() {
+		int interval = window / 2;
+		for (int id = 0; id < int(agents.size()); ++id) {
+			Agent& agent = agents[id];
+			if (!agent.active) {
+				continue;
+			}
+			int planned = agent.plan_start + int(agent.plan.size()) - 1;
+			if ((time + id) % interval == 0 || planned <= time) {
+				plan(id);
+			}
+		}
+
+		++time;
+		for (int id = 0; id < int(agents.size()); ++id) {
+			Agent& agent = agents[id];
+			if (!agent.active) {
+				continue;
+			}
+			int t = time - agent.plan_start;
+			if (t < int(agent.plan.size())) {
+				agent.cell = agent.plan[t];
+			}
+			if (agent.cell == graph.index(goal)) {
+				remove_agent(id);
+			}
+		}
+	}
+
+	// Who holds cell at tick t, -1 when free.
+	int reserved(int cell, int t) const {
+		auto found = reservations.find(key(cell, t));
+		return found != reservations.end() ? found->second : -1;
+	}
+
+private:
+	struct Agent {
+		int cell;
+		// cells from plan_start on, one per tick
+		vector<int> plan;
+		int plan_start;
+		bool active;
+	};
+
+	vector<Agent> agents;
+	// (tick, cell) -> agent
+	unordered_map<uint64_t, int> reservations;
+	// agent standing on each cell once its plan runs out, -1 for none
+	vector<int> parked;
+	// steps to the goal, the heuristic past the window
+	vector<int> distance;
+
+	// space-time search state, indexed by t * graph.size() + cell for
+	// t <= window
+	vector<int> parent;
+	vector<unsigned> seen;
+	unsigned generation;
+	BucketQueue<int> frontier;
+
+	static inline uint64_t key(int cell, int t) {
+		return (uint64_t(unsigned(t)) << 32) | unsigned(cell);
+	}
+
+	void release(int id) {
+		Agent& agent = agents[id];
+		for (size_t i = 0; i < agent.plan.size(); ++i) {
+			auto found = reservations.find(key(agent.plan[i], agent.plan_start + int(i)));
+			if (found != reservations.end() && found->second == id) {
+				reservations.erase(found);
+			}
+		}
+		int cell = agent.plan.empty() ? agent.cell : agent.plan.back();
+		if (parked[cell] == id) {
+			parked[cell] = -1;
+		}
+		agent.plan.clear();
+	}
+
+	inline bool available(int cell, int t, int id) const {
+		int holder = reserved(cell, t);
+		if (holder >= 0 && holder != id) {
+			return false;
+		}
+		holder = parked[cell];
+		return holder < 0 || holder == id || t < plan_end(holder);
+	}
+
+	// A* over (cell, tick) from the agent's cell now to the goal or to the
+	// end of the window, whichever comes first. Every action costs one
+	// tick, so g is the tick and f = t + distance never decreases.
+	void plan(int id) {
+		release(id);
+		Agent& agent = agents[id];
+		int size = graph.size();
+		size_t states = size_t(size) * (window + 1);
+		if (seen.size() != states) {
+			seen.assign(states, 0);
+			parent.resize(states);
+			generation = 0;
+		}
+		if (++generation == 0) {
+			std::fill(seen.begin(), seen.end(), 0);
+			generation = 1;
+		}
+		frontier.clear();
+
+		int g = graph.index(goal);
+		// hemmed in on every side, or cut off from the goal, the search ends
+		// without a state to take, and the agent stands still
+		int best = agent.cell;
+		seen[best] = generation;
+		parent[best] = -1;
+		if (distance[agent.cell] < INF) {
+			frontier.put(best, distance[agent.cell]);
+		}
+		while (!frontier.empty()) {
+			int state = frontier.get();
+			int t = state / size, cell = state % size;
+			if (cell == g || t == window) {
+				best = state;
+				break;
+			}
+			auto expand = [&](int next) {
+				int n = (t + 1) * size + next;
+				if (seen[n] == generation || distance[next] == INF || !available(next, time + t + 1, id)) {
+					return;
+				}
+				// two plans may not end on the same cell
+				if (t + 1 == window && parked[next] >= 0 && parked[next] != id) {
+					return;
+				}
+				// no swapping places with an agent coming the other way
+				int holder = reserved(next, time + t);
+				if (holder >= 0 && holder != id && reserved(cell, time + t + 1) == holder) {
+					return;
+				}
+				seen[n] = generation;
+				parent[n] = state;
+				frontier.put(n, t + 1 + distance[next]);
+			};
+			expand(cell);
+			graph.for_each_neighbor(graph.location(cell), [&](Location next) {
+				expand(graph.index(next));
+			});
+		}
+
+		agent.plan_start = time;
+		for (int state = best; state >= 0; state = parent[state]) {
+			agent.plan.push_back(state % size);
+		}
+		std::reverse(agent.plan.begin(), agent.plan.end());
+		for (size_t i = 0; i < agent.plan.size(); ++i) {
+			// the goal holds everyone
+			if (agent.plan[i] != g) {
+				reservations[key(agent.plan[i], time + int(i))] = id;
+			}
+		}
+		park(id);
+	}
+
+	// Past the end of its plan an agent is taken to stay where the plan
+	// ends, until it replans; otherwise the others, looking further ahead,
+	// would plan straight through it.
+	void park(int id) {
+		const Agent& agent = agents[id];
+		int cell = agent.plan.empty() ? agent.cell : agent.plan.back();
+		if (cell != graph.index(goal)) {
+			parked[cell] = id;
+		}
+	}
+
+	inline int plan_end(int id) const {
+		const Agent& agent = agents[id];
+		return agent.plan_start + std::max(int(agent.plan.size()) - 1, 0);
+	}
+};
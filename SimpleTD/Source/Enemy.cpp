@@ -2,14 +2,23 @@
 #include "Context.h"
 #include "Component.h"
 #include "Node.h"
+#include "CompressedPath.h"
+
+/// Most straight runs of a precomputed route passed in one step when they are all in sight.
+static const int MAX_SKIPPED_RUNS = 16;
 
 Enemy::Enemy(Context* context) : LogicComponent(context),
 path_(NULL),
+pathRequest_(0),
+routePath_(NULL),
+routeCursor_(NULL),
 onPathIndex_(0),
 maxHealth_(1.0f),
 health_(1.0f),
 followPath_(false),
+followRoute_(false),
 movePrc_(0.0f),
+stepLength_(1.0f),
 speed_(1.0f)
 {
 	SetUpdateEventMask(USE_UPDATE);
@@ -17,6 +26,8 @@ speed_(1.0f)
 
 Enemy::~Enemy()
 {
+	delete routeCursor_;
+	delete routePath_;
 }
 void Enemy::RegisterObject(Context* context)
 {
@@ -32,20 +43,24 @@ void Enemy::DelayedStart()
 
 void Enemy::Stop()
 {
+	if (pathRequest_ && pathService_)
+		pathService_->CancelPath(pathRequest_);
+	pathRequest_ = 0;
 }
 
 void Enemy::Update(float timeStep)
 {
-	if (path_ && followPath_)
+	if (followPath_)
 	{
 	
-			if (movePrc_ < 1.0f)movePrc_ += timeStep * speed_;
+			if (movePrc_ < 1.0f)movePrc_ += timeStep * speed_ / stepLength_;
 			if (movePrc_ > 1.0f)movePrc_ = 1.0f;
 
 			//Goal reached
 			if (movePrc_ == 1.0f)
 			{
-				if (onPathIndex_ + 1 >= path_->Size())
+				lastPathPoint_ = nextPathPoint_;
+				if (!AdvanceWaypoint())
 				{
 					// end of path :-) 
 					Explode(false);					
@@ -53,15 +68,12 @@ void Enemy::Update(float timeStep)
 				}
 				else  //Next Waypoint
 				{
-					lastPathPoint_ = path_->At(onPathIndex_);
 					movePrc_ = 0.0f;
-					onPathIndex_++;
-
 				}
 			}
 
 			//Interpolate position between last and next path point
-			node_->SetPosition2D(lastPathPoint_ * (1.0f - movePrc_) + path_->At(onPathIndex_) * movePrc_);
+			node_->SetPosition2D(lastPathPoint_ * (1.0f - movePrc_) + nextPathPoint_ * movePrc_);
 
 	}
 }
@@ -110,14 +122,211 @@ void Enemy::FollowPath(Vector<Vector2> *path)
 	if (path != NULL && path->Size()>0)
 	{
 		path_ = path;
+		flowField_.Reset();
+		followRoute_ = false;
 		onPathIndex_ = 0;
 		followPath_ = true;
 		lastPathPoint_ = path_->At(0);
+		nextPathPoint_ = lastPathPoint_;
 		movePrc_ = 1.0f;
 		node_->SetPosition2D(lastPathPoint_);
 	}
 }
 
+void Enemy::FollowFlowField(FlowField* field, const IntVector2& tile)
+{
+	if (field != NULL)
+	{
+		path_ = NULL;
+		flowField_ = field;
+		followRoute_ = false;
+		tile_ = tile;
+		followPath_ = true;
+		lastPathPoint_ = flowField_->GetTilePosition(tile_);
+		nextPathPoint_ = lastPathPoint_;
+		movePrc_ = 1.0f;
+		node_->SetPosition2D(lastPathPoint_);
+	}
+}
+
+void Enemy::FollowRoute(FlowField* field, unsigned source, unsigned route)
+{
+	if (field == NULL || route >= field->GetNumRoutes(source))
+		return;
+
+	if (!routePath_)
+	{
+		routePath_ = new CompressedPath();
+		routeCursor_ = new PathCursor();
+	}
+	field->GetRoute(source, route, *routePath_);
+	*routeCursor_ = PathCursor(*routePath_);
+
+	path_ = NULL;
+	flowField_ = field;
+	followRoute_ = true;
+	tile_ = IntVector2(std::get<0>(routePath_->start), std::get<1>(routePath_->start));
+	followPath_ = true;
+	lastPathPoint_ = flowField_->GetTilePosition(tile_);
+	nextPathPoint_ = lastPathPoint_;
+	movePrc_ = 1.0f;
+	node_->SetPosition2D(lastPathPoint_);
+}
+
+void Enemy::FollowPathRequest(PathRequestService* service, unsigned handle)
+{
+	if (service == NULL || handle == 0)
+		return;
+
+	if (pathRequest_ && pathService_)
+		pathService_->CancelPath(pathRequest_);
+
+	pathService_ = service;
+	pathRequest_ = handle;
+	SubscribeToEvent(service, E_PATHCOMPLETED, HANDLER(Enemy, HandlePathCompleted));
+}
+
+void Enemy::HandlePathCompleted(StringHash eventType, VariantMap& eventData)
+{
+	using namespace PathCompleted;
+
+	if (eventData[P_HANDLE].GetUInt() != pathRequest_)
+		return;
+
+	pathRequest_ = 0;
+	UnsubscribeFromEvent(pathService_, E_PATHCOMPLETED);
+	// without a path keep walking the old route
+	Vector<Vector2> path;
+	PODVector<IntVector2> tiles;
+	if (!pathService_ || !pathService_->TakePath(eventData[P_HANDLE].GetUInt(), path, &tiles) || path.Empty())
+		return;
+
+	if (!followPath_)
+	{
+		route_ = path;
+		routeTiles_ = tiles;
+		FollowPath(&route_);
+		tile_ = routeTiles_[0];
+		return;
+	}
+
+	// the search took a few frames, so the enemy has moved on from where it started;
+	// join at the nearest tile it can walk to straight, the later one on a tie
+	int join = -1;
+	float joinDistance = 0.0f;
+	for (unsigned i = 0; i < tiles.Size(); ++i)
+	{
+		IntVector2 offset = tiles[i] - tile_;
+		float distance = Vector2(float(offset.x_), float(offset.y_)).Length();
+		if ((join < 0 || distance <= joinDistance) && HasLineOfSight(tile_, tiles[i]))
+		{
+			join = i;
+			joinDistance = distance;
+		}
+	}
+	if (join < 0)
+		return;
+
+	route_ = path;
+	routeTiles_ = tiles;
+	// the flow field, if any, stays as the way on should a tower block the path
+	path_ = &route_;
+	followRoute_ = false;
+	// finish the current step first; if it leads to the joining tile, go on from there
+	onPathIndex_ = routeTiles_[join] == tile_ ? join : join - 1;
+}
+
+bool Enemy::HasLineOfSight(const IntVector2& from, const IntVector2& to) const
+{
+	if (flowField_)
+		return flowField_->HasLineOfSight(from, to);
+	if (pathService_)
+		return pathService_->HasLineOfSight(from, to);
+	return true;
+}
+
+bool Enemy::AdvanceWaypoint()
+{
+	if (followRoute_)
+	{
+		PathCursor ahead = *routeCursor_;
+		// a route leaves for the flow field where a tower went up since it was built
+		if (ahead.skip_run() > 0 && flowField_->HasLineOfSight(tile_, IntVector2(std::get<0>(ahead.at), std::get<1>(ahead.at))))
+		{
+			// cut across the ends of the runs still in sight
+			*routeCursor_ = ahead;
+			for (int i = 1; i < MAX_SKIPPED_RUNS && ahead.skip_run() > 0; ++i)
+			{
+				if (!flowField_->HasLineOfSight(tile_, IntVector2(std::get<0>(ahead.at), std::get<1>(ahead.at))))
+					break;
+				*routeCursor_ = ahead;
+			}
+
+			IntVector2 from = tile_;
+			tile_ = IntVector2(std::get<0>(routeCursor_->at), std::get<1>(routeCursor_->at));
+			stepLength_ = Vector2(float(tile_.x_ - from.x_), float(tile_.y_ - from.y_)).Length();
+			nextPathPoint_ = flowField_->GetTilePosition(tile_);
+			return true;
+		}
+		followRoute_ = false;
+	}
+
+	if (path_)
+	{
+		if (onPathIndex_ + 1 >= (int)path_->Size())
+			return false;
+
+		// a requested path leaves for the flow field where a tower went up since it was found,
+		// or without one asks again from here
+		if (path_ == &route_ && !HasLineOfSight(tile_, routeTiles_[onPathIndex_ + 1]))
+		{
+			path_ = NULL;
+			if (!flowField_ && pathService_)
+				FollowPathRequest(pathService_, pathService_->RequestPath(tile_, routeTiles_.Back()));
+		}
+		else
+		{
+			onPathIndex_++;
+			nextPathPoint_ = path_->At(onPathIndex_);
+			stepLength_ = 1.0f;
+			if (path_ == &route_)
+			{
+				// any-angle paths skip tiles, so a step can be longer than one tile
+				IntVector2 from = tile_;
+				tile_ = routeTiles_[onPathIndex_];
+				float length = Vector2(float(tile_.x_ - from.x_), float(tile_.y_ - from.y_)).Length();
+				if (length > 1.0f)
+					stepLength_ = length;
+			}
+			return true;
+		}
+	}
+
+	if (flowField_)
+	{
+		if (tile_ == flowField_->GetGoal())
+			return false;
+
+		// Wait in place while the goal is cut off
+		IntVector2 next;
+		if (flowField_->GetNextTile(tile_, next))
+			tile_ = next;
+		stepLength_ = 1.0f;
+
+		nextPathPoint_ = flowField_->GetTilePosition(tile_);
+		return true;
+	}
+
+	// Wait in place for the new path
+	if (pathRequest_)
+	{
+		stepLength_ = 1.0f;
+		return true;
+	}
+
+	return false;
+}
+
 void Enemy::SetSpeed(float s)
 {
 	if (s<0.0f)
@@ -1,5 +1,10 @@
 #pragma once
 #include "LogicComponent.h"
+#include "FlowField.h"
+#include "PathRequestService.h"
+
+struct PathCursor;
+
 namespace Urho3D
 {
 
@@ -45,16 +50,47 @@ public:
 	void Explode(bool gainMoney);
 
 	void FollowPath(Vector<Vector2> *path);
-	
+	/// Walk down the flow field towards its goal, starting at tile.
+	void FollowFlowField(FlowField* field, const IntVector2& tile);
+	/// Walk one of the field's precomputed routes, cutting corners in line of sight and taking the flow field from where a tower blocks it.
+	void FollowRoute(FlowField* field, unsigned source, unsigned route);
+	/// Keep the current route until the request completes, then walk the new path. Request it from GetTile() to continue without a detour.
+	void FollowPathRequest(PathRequestService* service, unsigned handle);
+	/// Return the tile the enemy is walking to, when following a flow field or a requested path.
+	const IntVector2& GetTile() const { return tile_; }
+
 
 protected:
+	/// Pick the next waypoint. Returns false when the end of the route is reached.
+	bool AdvanceWaypoint();
+	/// Return whether the straight line between the tiles is walkable, on whichever map the enemy walks.
+	bool HasLineOfSight(const IntVector2& from, const IntVector2& to) const;
+	/// Switch to the requested path once it is found, joining it at the nearest tile in sight.
+	void HandlePathCompleted(StringHash eventType, VariantMap& eventData);
+
 	Vector<Vector2> *path_;
+	SharedPtr<FlowField> flowField_;
+	/// Path request waiting for completion, 0 when none.
+	WeakPtr<PathRequestService> pathService_;
+	unsigned pathRequest_;
+	/// Positions and tiles of the last requested path; path_ points here while it is walked.
+	Vector<Vector2> route_;
+	PODVector<IntVector2> routeTiles_;
+	/// Copy of the precomputed route being walked and the position on it, created on the first FollowRoute.
+	CompressedPath* routePath_;
+	PathCursor* routeCursor_;
+	IntVector2 tile_;
 	Vector2 lastPathPoint_;
+	Vector2 nextPathPoint_;
 	int onPathIndex_;
 	float speed_;
 	float maxHealth_;
 	float health_;
 	bool followPath_;
+	/// Whether the precomputed route is walked, before falling back to the flow field.
+	bool followRoute_;
 	float movePrc_;
+	/// Length in tiles of the step from lastPathPoint_ to nextPathPoint_; longer on any-angle routes.
+	float stepLength_;
 private:
 };
@@ -0,0 +1,213 @@
+#include "FlowField.h"
+#include "Pathfinding.h"
+#include "BlockingOracle.h"
+#include "AlternativeRoutes.h"
+#include "AnyAnglePath.h"
+#include "CompressedPath.h"
+
+static const unsigned char NO_DIRECTION = 0xff;
+
+FlowField::FlowField(const TileMapInfo2D& info) :
+planner_(NULL),
+oracle_(NULL),
+info_(info),
+width_(0),
+height_(0),
+routesPerSource_(0),
+routesStale_(false)
+{
+}
+
+FlowField::~FlowField()
+{
+	delete oracle_;
+	delete planner_;
+}
+
+void FlowField::Build(const DenseGrid& grid, const IntVector2& goal)
+{
+	width_ = grid.width;
+	height_ = grid.height;
+	goal_ = goal;
+
+	delete oracle_;
+	delete planner_;
+	planner_ = new DStarLite<DenseGrid>(grid, DenseGrid::Location{ goal.x_, goal.y_ });
+	oracle_ = new BlockingOracle<DenseGrid>(planner_->grid, planner_->goal, vector<DenseGrid::Location>());
+
+	distances_.Resize(grid.size());
+	directions_.Resize(grid.size());
+	for (int i = 0; i < grid.size(); ++i)
+		UpdateTile(i);
+}
+
+void FlowField::SetWalkable(const IntVector2& tile, bool walkable)
+{
+	if (!planner_ || !InBounds(tile))
+		return;
+
+	planner_->set_wall(DenseGrid::Location{ tile.x_, tile.y_ }, !walkable);
+	planner_->compute();
+
+	// directions depend on the neighbors' distances, so refresh those too
+	const DenseGrid& grid = planner_->grid;
+	for (unsigned i = 0; i < planner_->changed.size(); ++i)
+	{
+		int index = planner_->changed[i];
+		UpdateTile(index);
+		for (int j = 0; j < 4; ++j)
+		{
+			int dx, dy;
+			tie(dx, dy) = SquareGrid::DIRS[j];
+			DenseGrid::Location next(index % width_ + dx, index / width_ + dy);
+			if (grid.in_bounds(next))
+				UpdateTile(grid.index(next));
+		}
+	}
+	planner_->clear_changed();
+
+	// IsBlocking() rebuilds the cut table only when a tile may be a narrow pass
+	oracle_->stale = true;
+	// enemies leave a blocked route for the field, so the searches can wait for UpdateRoutes()
+	routesStale_ = routesPerSource_ > 0;
+}
+
+void FlowField::SetSources(const PODVector<IntVector2>& sources)
+{
+	if (!oracle_)
+		return;
+
+	sources_ = sources;
+	oracle_->sources.clear();
+	for (unsigned i = 0; i < sources.Size(); ++i)
+	{
+		if (InBounds(sources[i]))
+			oracle_->sources.push_back(DenseGrid::Location{ sources[i].x_, sources[i].y_ });
+	}
+	oracle_->rebuild();
+}
+
+bool FlowField::IsWalkable(const IntVector2& tile) const
+{
+	if (!planner_ || !InBounds(tile))
+		return false;
+
+	return planner_->grid.passable(DenseGrid::Location{ tile.x_, tile.y_ });
+}
+
+void FlowField::UpdateRoutes()
+{
+	if (routesStale_)
+		BuildRoutes(routesPerSource_);
+}
+
+void FlowField::BuildRoutes(unsigned count)
+{
+	routesPerSource_ = count;
+	routesStale_ = false;
+	routeRuns_.Clear();
+	routeStarts_.Clear();
+	routeOffsets_.Clear();
+	sourceRoutes_.Clear();
+	routeOffsets_.Push(0);
+	sourceRoutes_.Push(0);
+	if (!planner_)
+		return;
+
+	const DenseGrid& grid = planner_->grid;
+	vector<DenseGrid::Location> tiles;
+	CompressedPath packed;
+	for (unsigned i = 0; i < sources_.Size(); ++i)
+	{
+		if (count > 0 && InBounds(sources_[i]))
+		{
+			RouteSet routes = diverse_routes(grid, DenseGrid::Location{ sources_[i].x_, sources_[i].y_ }, planner_->goal, int(count));
+			for (int r = 0; r < routes.size(); ++r)
+			{
+				tiles.clear();
+				for (const int* cell = routes.begin(r); cell != routes.end(r); ++cell)
+					tiles.push_back(grid.location(*cell));
+				packed.assign(tiles.begin(), tiles.end());
+				routeStarts_.Push(IntVector2(std::get<0>(packed.start), std::get<1>(packed.start)));
+				for (unsigned j = 0; j < packed.runs.size(); ++j)
+					routeRuns_.Push(packed.runs[j]);
+				routeOffsets_.Push(routeRuns_.Size());
+			}
+		}
+		sourceRoutes_.Push(routeStarts_.Size());
+	}
+}
+
+unsigned FlowField::GetNumRoutes(unsigned source) const
+{
+	if (source + 1 >= sourceRoutes_.Size())
+		return 0;
+
+	return sourceRoutes_[source + 1] - sourceRoutes_[source];
+}
+
+bool FlowField::GetRoute(unsigned source, unsigned route, CompressedPath& path) const
+{
+	if (route >= GetNumRoutes(source))
+		return false;
+
+	unsigned index = sourceRoutes_[source] + route;
+	path.start = CompressedPath::Location(routeStarts_[index].x_, routeStarts_[index].y_);
+	path.runs.assign(routeRuns_.Begin() + routeOffsets_[index], routeRuns_.Begin() + routeOffsets_[index + 1]);
+	path.length = 0;
+	for (unsigned i = 0; i < path.runs.size(); ++i)
+		path.length += (path.runs[i] >> 2) + 1;
+	return true;
+}
+
+bool FlowField::IsBlocking(const IntVector2& tile) const
+{
+	if (!oracle_ || !InBounds(tile))
+		return false;
+
+	return oracle_->blocks(DenseGrid::Location{ tile.x_, tile.y_ });
+}
+
+bool FlowField::HasLineOfSight(const IntVector2& from, const IntVector2& to) const
+{
+	if (!planner_ || !InBounds(from) || !InBounds(to))
+		return false;
+
+	return line_of_sight(planner_->grid, DenseGrid::Location{ from.x_, from.y_ }, DenseGrid::Location{ to.x_, to.y_ });
+}
+
+void FlowField::UpdateTile(int index)
+{
+	DenseGrid::Location id = planner_->grid.location(index);
+	int distance = planner_->distance(id);
+	distances_[index] = distance < DStarLite<DenseGrid>::INF ? distance : -1;
+
+	DenseGrid::Location next;
+	if (planner_->next_step(id, next))
+		directions_[index] = (unsigned char)direction_code(std::get<0>(next) - std::get<0>(id), std::get<1>(next) - std::get<1>(id));
+	else
+		directions_[index] = NO_DIRECTION;
+}
+
+int FlowField::GetDistance(const IntVector2& tile) const
+{
+	if (!InBounds(tile))
+		return -1;
+
+	return distances_[tile.y_ * width_ + tile.x_];
+}
+
+bool FlowField::GetNextTile(const IntVector2& tile, IntVector2& next) const
+{
+	if (!InBounds(tile))
+		return false;
+
+	unsigned char direction = directions_[tile.y_ * width_ + tile.x_];
+	if (direction == NO_DIRECTION)
+		return false;
+
+	int dx, dy;
+	tie(dx, dy) = SquareGrid::DIRS[direction];
+	next = IntVector2(tile.x_ + dx, tile.y_ + dy);
+	return true;
+}
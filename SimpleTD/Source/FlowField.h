@@ -0,0 +1,93 @@
+#pragma once
+#include "RefCounted.h"
+#include "Vector.h"
+#include "Vector2.h"
+#include "TileMapDefs2D.h"
+
+struct DenseGrid;
+template<typename Grid> struct DStarLite;
+template<typename Graph> struct BlockingOracle;
+struct CompressedPath;
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Per-tile distance and direction towards one goal tile. Filled by a single reverse search
+/// from the goal, then shared by every enemy no matter where it spawns. Walkability changes
+/// are repaired incrementally, touching only the tiles whose distance changed.
+class FlowField : public RefCounted
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	FlowField(const TileMapInfo2D& info);
+	~FlowField();
+
+	/// Fill the field with a reverse breadth first search from goal.
+	void Build(const DenseGrid& grid, const IntVector2& goal);
+	/// Make tile walkable or not and repair the affected part of the field.
+	void SetWalkable(const IntVector2& tile, bool walkable);
+	/// Set the tiles that must keep a route to the goal, e.g. the spawn points.
+	void SetSources(const PODVector<IntVector2>& sources);
+	/// Precompute up to count distinct near-shortest routes from every source. Routes are kept as one byte per straight run.
+	void BuildRoutes(unsigned count);
+	/// Precompute the routes again if walkability changed since, e.g. between waves. Until then they may run into new walls.
+	void UpdateRoutes();
+
+	/// Return the number of precomputed routes from a source.
+	unsigned GetNumRoutes(unsigned source) const;
+	/// Copy out a precomputed route, from the source to the goal. Returns false if there is no such route.
+	bool GetRoute(unsigned source, unsigned route, CompressedPath& path) const;
+
+	/// Return whether tile is currently walkable.
+	bool IsWalkable(const IntVector2& tile) const;
+	/// Return whether the goal can be reached from tile.
+	bool IsReachable(const IntVector2& tile) const { return GetDistance(tile) >= 0; }
+	/// Return whether making tile a wall would cut a source off the goal. Constant time, except for the first narrow pass asked after walls changed, which rebuilds the cut table.
+	bool IsBlocking(const IntVector2& tile) const;
+	/// Return whether the straight line between the centers of two tiles touches walkable tiles only.
+	bool HasLineOfSight(const IntVector2& from, const IntVector2& to) const;
+	/// Return steps from tile to the goal, or -1 when unreachable.
+	int GetDistance(const IntVector2& tile) const;
+	/// Get the neighbor tile one step closer to the goal. Returns false on the goal or when unreachable.
+	bool GetNextTile(const IntVector2& tile, IntVector2& next) const;
+	/// Return world position of tile.
+	Vector2 GetTilePosition(const IntVector2& tile) const { return info_.TileIndexToPosition(tile.x_, tile.y_); }
+
+	const IntVector2& GetGoal() const { return goal_; }
+	int GetWidth() const { return width_; }
+	int GetHeight() const { return height_; }
+
+protected:
+	bool InBounds(const IntVector2& tile) const { return tile.x_ >= 0 && tile.x_ < width_ && tile.y_ >= 0 && tile.y_ < height_; }
+	/// Copy distance and direction of one tile from the planner.
+	void UpdateTile(int index);
+
+	/// Incremental planner holding the walkable grid and distances to the goal.
+	DStarLite<DenseGrid>* planner_;
+	/// Cut tiles of the planner's grid between the sources and the goal.
+	BlockingOracle<DenseGrid>* oracle_;
+	TileMapInfo2D info_;
+	IntVector2 goal_;
+	int width_;
+	int height_;
+	/// Tiles that must keep a route to the goal.
+	PODVector<IntVector2> sources_;
+	/// Routes asked for per source, 0 when none are kept.
+	unsigned routesPerSource_;
+	/// Whether walkability changed since the routes were built.
+	bool routesStale_;
+	/// Run-length encoded steps of all routes, back to back, see CompressedPath.
+	PODVector<unsigned char> routeRuns_;
+	/// First tile of every route.
+	PODVector<IntVector2> routeStarts_;
+	/// Route i is routeRuns_[routeOffsets_[i]] up to routeRuns_[routeOffsets_[i + 1]].
+	PODVector<unsigned> routeOffsets_;
+	/// Routes of source i are sourceRoutes_[i] up to sourceRoutes_[i + 1].
+	PODVector<unsigned> sourceRoutes_;
+	/// Steps to the goal per tile, -1 when unreachable.
+	PODVector<int> distances_;
+	/// Index into SquareGrid::DIRS per tile, NO_DIRECTION on the goal and unreachable tiles.
+	PODVector<unsigned char> directions_;
+};
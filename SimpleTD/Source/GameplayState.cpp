@@ -71,8 +71,12 @@
 #define ENEMY_SPAWN_INTERVAL 0.85f // seconds
 #define ENEMY_SPEED 3.30f
 #define PLAYER_LIFE 10
+#define ROUTES_PER_SPAWN 4
+#define SMART_ENEMY_INTERVAL 4 // every fourth enemy routes around the towers
+#define THREAT_COST 2.0f // extra tiles per damage per second
 GameState::GameState(Context* context) : State(context),
 wave_(0),
+nextSpawnPoint_(0),
 enemiesAlive_(0),
 enemiesToSpawn_(0),
 waveTimer_(5.0f),
@@ -168,17 +172,17 @@ void GameState::CreateScene()
 		ResourceCache* cache = GetSubsystem<ResourceCache>();
 
 		// create Tile Grid from the Terrain layer. every existing tile is walkable, so set only wall tiles, which are not defined tiles.
-		SquareGrid grid(terrainlayer->GetWidth(), terrainlayer->GetHeight());
+		DenseGrid grid(terrainlayer->GetWidth(), terrainlayer->GetHeight());
 		for (int x = 0; x < terrainlayer->GetWidth(); ++x) {
 			for (int y = 0; y < terrainlayer->GetHeight(); ++y) {
 				if (!terrainlayer->GetTile(x, y))
-					grid.walls.insert(SquareGrid::Location{ x, y });
+					grid.add_wall(DenseGrid::Location{ x, y });
 			}
 		}
 		// retrieve Start and end points from events object layer		// 		SquareGrid::Location startPoint;
 		// 		SquareGrid::Location goalPoint;
-		Vector2 startPoint;
 		Vector2 goalPoint;
+		spawnPoints_.Clear();
 		TileMapObject2D* tower = NULL;
 		for (int i = 0; i < eventsLayer->GetNumObjects(); ++i)
 		{
@@ -197,9 +201,10 @@ void GameState::CreateScene()
 				Vector2 pixelPos = obj->GetPosition();
 				pixelPos.y_ = (info.GetMapHeight() - pixelPos.y_) - obj->GetSize().y_;
 				pixelPos /= PIXEL_SIZE;
+				Vector2 startPoint;
 				startPoint.y_ = pixelPos.y_ / (info.tileHeight_ / PIXEL_SIZE);
 				startPoint.x_ = pixelPos.x_ / (info.tileWidth_ / PIXEL_SIZE);
-				//startPoint = SquareGrid::Location{ gridPos.x_, gridPos.y_ };
+				spawnPoints_.Push(IntVector2(int(startPoint.x_), int(startPoint.y_)));
 			}
 			else if (obj->GetName() == "Tower")
 			{
@@ -222,9 +227,18 @@ void GameState::CreateScene()
 			}
 		}
 
-		// create path for the enemy to walk on.
-		auto parents = breadth_first_search(grid, SquareGrid::Location{ int(startPoint.x_), int(startPoint.y_) }, SquareGrid::Location{ int(goalPoint.x_), int(goalPoint.y_) });
-		vector<SquareGrid::Location> path = reconstruct_path(SquareGrid::Location{ int(startPoint.x_), int(startPoint.y_) }, SquareGrid::Location{ int(goalPoint.x_), int(goalPoint.y_) }, parents);
+		// create one flow field towards the goal, shared by all enemies from every spawn point.
+		flowField_ = new FlowField(info);
+		flowField_->Build(grid, IntVector2(int(goalPoint.x_), int(goalPoint.y_)));
+		flowField_->SetSources(spawnPoints_);
+		// a few distinct routes per spawn point spread the waves out without any search while spawning
+		flowField_->BuildRoutes(ROUTES_PER_SPAWN);
+
+		// enemies that need a route of their own ask here; the searches run a slice per frame
+		pathService_ = new PathRequestService(context_);
+		pathService_->SetGrid(grid, info);
+		pathService_->SetAnyAngle(true);
+		pathService_->SetThreatCost(THREAT_COST);
 
 		// Construct debug text
 		//		UI* ui = GetSubsystem<UI>();
@@ -232,16 +246,7 @@ void GameState::CreateScene()
 		// 		maptext->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 15);
 		// 		maptext->SetHorizontalAlignment(HA_CENTER);
 		// 		maptext->SetVerticalAlignment(VA_CENTER);
-		//		maptext->SetText(draw_grid_to_String(grid, 2, nullptr, nullptr, &path).c_str());
-
-		// create usable path for the enemy component.
-		path_.Clear();
-		for (int i = path.size() - 1; i >= 0; i--)
-		{
-			Vector2 pos(std::get<0>(path.at(i)), std::get<1>(path.at(i)));
-
-			path_.Push(info.TileIndexToPosition(pos.x_, pos.y_));
-		}
+		//		maptext->SetText(draw_grid_to_String(grid, 2, nullptr, nullptr, nullptr).c_str());
 
 		waveInfo_->SetVisible(true);
 
@@ -504,6 +509,12 @@ void GameState::HandleUpdate(StringHash eventType, VariantMap& eventData)
 				
 				tempTowerNode_->SetPosition2D(tileMap_->GetInfo().TileIndexToPosition(x, y));
 
+				// show in red where a tower would wall the enemies off the goal
+				IntVector2 tile(x, y);
+				bool blocked = flowField_ && flowField_->IsWalkable(tile) && flowField_->IsBlocking(tile);
+				StaticSprite2D* staticSprite = tempTowerNode_->GetComponent<StaticSprite2D>();
+				if (staticSprite)
+					staticSprite->SetColor(blocked ? Color::RED : Color::GRAY);
 			}
 		}
 	}
@@ -515,7 +526,9 @@ void GameState::End()
 	scene_.Reset();
 	cameraNode_.Reset();
 	tileMap_.Reset();
-	path_.Clear();
+	flowField_.Reset();
+	pathService_.Reset();
+	spawnPoints_.Clear();
 	enemies_.Clear();
 	if (GetSubsystem<UI>())
 	{
@@ -578,6 +591,10 @@ void GameState::SpawnWave()
 	enemiesToSpawn_ = enemiesAlive_;
 	enemyTimer_ = 0.0f;
 
+	// routes changed by the towers built since the last wave are searched again now, once
+	if (flowField_)
+		flowField_->UpdateRoutes();
+
 	String str;
 	str.AppendWithFormat("Wave %i ", wave_);
 	waveInfo_->SetText(str);
@@ -605,7 +622,20 @@ void GameState::SpawnEnemy()
 	staticSprite->SetLayer(5 * 10);
 	/// create Enemy component which controls the Enemy behavior
 	Enemy* e = enemySpriteNode_->CreateComponent<Enemy>();
-	e->FollowPath(&path_);
+	if (flowField_ && !spawnPoints_.Empty())
+	{
+		// cycle through the spawn points, and through the routes of each
+		unsigned spawn = nextSpawnPoint_ % spawnPoints_.Size();
+		unsigned routes = flowField_->GetNumRoutes(spawn);
+		if (routes > 0)
+			e->FollowRoute(flowField_, spawn, (nextSpawnPoint_ / spawnPoints_.Size()) % routes);
+		else
+			e->FollowFlowField(flowField_, spawnPoints_[spawn]);
+		// smart enemies leave the route once a path around the defended tiles is found
+		if (nextSpawnPoint_ % SMART_ENEMY_INTERVAL == SMART_ENEMY_INTERVAL - 1)
+			e->FollowPathRequest(pathService_, pathService_->RequestPath(e->GetTile(), flowField_->GetGoal()));
+		nextSpawnPoint_++;
+	}
 	e->SetSpeed(ENEMY_SPEED + wave_*0.3f);
 	e->SetMaxHealth((wave_ / 3) + 1.0f);
 	e->SetHealth((wave_ / 3) + 1.0f);
@@ -633,6 +663,7 @@ void GameState::GameOver()
 void GameState::ResetGame()
 {
 	wave_ = 0;
+	nextSpawnPoint_ = 0;
 	enemiesAlive_ = 0;
 	enemiesToSpawn_ = 0;
 	waveTimer_ = 5.0f;
@@ -646,6 +677,7 @@ void GameState::ResetGame()
 
 	enemies_.Clear();
 	towers_.Clear();
+	roadTowers_.Clear();
 	String str;
 	str.AppendWithFormat("Lifes %i Money %i", lifes_, money_);
 	playerInfo_->SetText(str);
@@ -695,9 +727,8 @@ void GameState::HandleBackPressed(StringHash eventType, VariantMap& eventData)
 
 void GameState::HandleSellPressed(StringHash eventType, VariantMap& eventData)
 {
-	canelButton_->SetVisible(true);
-	SetUpgradeMenu(false);
-	SetBuyMenu(false);
+	SellTower();
+	HandleCancelPressed(eventType, eventData);
 }
 
 void GameState::HandleUpgradePressed(StringHash eventType, VariantMap& eventData)
@@ -714,6 +745,7 @@ void GameState::HandleUpgradePressed(StringHash eventType, VariantMap& eventData
 			if (money_ >= prize) {
 				money_ -= prize;
 				selectedTower_->UpgradeRange();
+				UpdateThreat(selectedTower_);
 				UpdateUpgradeLabels();
 			}
 			
@@ -724,6 +756,7 @@ void GameState::HandleUpgradePressed(StringHash eventType, VariantMap& eventData
 			if (money_ >= prize) {
 				money_ -= prize;
 				selectedTower_->UpgradeDamage();
+				UpdateThreat(selectedTower_);
 				UpdateUpgradeLabels();
 			}
 			
@@ -734,6 +767,7 @@ void GameState::HandleUpgradePressed(StringHash eventType, VariantMap& eventData
 			if (money_ >= prize) {
 				money_ -= prize;
 				selectedTower_->UpgradeFirerate();
+				UpdateThreat(selectedTower_);
 				UpdateUpgradeLabels();
 			}
 			
@@ -784,23 +818,33 @@ void GameState::PlaceTower()
 			if (!temp.Expired())
 				return;
 
-			SharedPtr<Node> towerNode_(scene_->CreateChild("Tower"));
-			towerNode_->SetPosition2D(tileMap_->GetInfo().TileIndexToPosition(x,y));
-			SharedPtr<Tower> t(towerNode_->CreateComponent<Tower>());
-			t->SetEnemies(&enemies_);
-
 			ResourceCache* cache = GetSubsystem<ResourceCache>();
 			// create enemy
 			SpriteSheet2D* 	spriteSheet = cache->GetResource<SpriteSheet2D>("Tilemaps/TileMapSprites.xml");
 			if (!spriteSheet)
 				return;
 
+			// towers on the road become walls the enemies route around; nothing can fail after this
+			bool onRoad = flowField_ && flowField_->IsWalkable(IntVector2(x, y));
+			if (onRoad && !BlockTile(IntVector2(x, y)))
+				return;
+
+			SharedPtr<Node> towerNode_(scene_->CreateChild("Tower"));
+			towerNode_->SetPosition2D(tileMap_->GetInfo().TileIndexToPosition(x,y));
+			SharedPtr<Tower> t(towerNode_->CreateComponent<Tower>());
+			t->SetEnemies(&enemies_);
+			t->SetTile(IntVector2(x, y));
+			t->SetInitialCost(towerPrice_);
+
 			StaticSprite2D* staticSprite = towerNode_->CreateComponent<StaticSprite2D>();
 			spriteSheet->GetSprite("Tower")->SetHotSpot(Vector2(0.0f, 0.0f));
 			staticSprite->SetSprite(spriteSheet->GetSprite("Tower"));
 			staticSprite->SetLayer(5 * 10);
 			
 			towers_[MakePair(x,y)]=towerNode_;
+			UpdateThreat(t);
+			if (onRoad)
+				roadTowers_.Insert(MakePair(x, y));
 			money_ -= towerPrice_;
 			towerPrice_ += int(towerPrice_ * 0.3f);
 			String str;
@@ -816,6 +860,51 @@ void GameState::PlaceTower()
 	}
 }
 
+bool GameState::BlockTile(const IntVector2& tile)
+{
+	// the goal and the spawn points count as blocking too
+	if (flowField_->IsBlocking(tile))
+		return false;
+
+	flowField_->SetWalkable(tile, false);
+	pathService_->SetWalkable(tile, false);
+	return true;
+}
+
+void GameState::UpdateThreat(Tower* tower)
+{
+	if (!pathService_)
+		return;
+
+	// the map counts range in tiles
+	float tileSize = tileMap_->GetInfo().tileWidth_;
+	pathService_->SetThreat(tower->GetTile(), tower->GetRange() / tileSize, tower->GetDamagePerSecond());
+}
+
+void GameState::SellTower()
+{
+	if (selectedTower_.Expired())
+		return;
+
+	IntVector2 tile = selectedTower_->GetTile();
+	money_ += selectedTower_->GetSellValue();
+	towers_.Erase(MakePair(tile.x_, tile.y_));
+	if (roadTowers_.Erase(MakePair(tile.x_, tile.y_)) && flowField_)
+	{
+		flowField_->SetWalkable(tile, true);
+		pathService_->SetWalkable(tile, true);
+	}
+	if (pathService_)
+		pathService_->SetThreat(tile, 0.0f, 0.0f);
+
+	selectedTower_->GetNode()->Remove();
+	selectedTower_.Reset();
+
+	String str;
+	str.AppendWithFormat("Lifes %i Money %i", lifes_, money_);
+	playerInfo_->SetText(str);
+}
+
 void GameState::HandleMouseButtonUpPressed(StringHash eventType, VariantMap& eventData)
 {
 	using namespace MouseButtonUp;
@@ -39,7 +39,10 @@
 #include "Drawable.h"
 #include "Plane.h"
 #include "Pair.h"
+#include "HashSet.h"
 #include "Tower.h"
+#include "FlowField.h"
+#include "PathRequestService.h"
 
 
 // All Urho3D classes reside in namespace Urho3D
@@ -111,6 +114,11 @@ private:
 	void HandleMouseButtonUpPressed(StringHash eventType, VariantMap& eventData);
 
 	void PlaceTower();
+	/// Turn a road tile into a wall, unless that cuts a spawn point off the goal.
+	bool BlockTile(const IntVector2& tile);
+	/// Hand the tower's range and damage to the threat map smart enemies route around.
+	void UpdateThreat(Tower* tower);
+	void SellTower();
 	bool Raycast(float maxDistance, Vector3& hitPos, Drawable*& hitDrawable);
 	bool RaycastWithPlane(Vector3& hitPos);
 	void ClickedOnTower();
@@ -131,7 +139,10 @@ private:
 	SharedPtr<TileMap2D> tileMap_;
 
 	// Pathfinding
-	Vector<Vector2> path_;
+	SharedPtr<FlowField> flowField_;
+	SharedPtr<PathRequestService> pathService_;
+	PODVector<IntVector2> spawnPoints_;
+	unsigned nextSpawnPoint_;
 
 	// Wave
 	int wave_;
@@ -144,6 +155,8 @@ private:
 
 	Vector<WeakPtr<Node>> enemies_;
 	HashMap<Pair<int,int>,WeakPtr<Node>> towers_;
+	/// Towers standing on road tiles, which reopen when sold.
+	HashSet<Pair<int,int>> roadTowers_;
 	WeakPtr<Tower> selectedTower_;
 	// Player
 	int money_;
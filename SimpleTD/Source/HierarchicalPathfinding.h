@@ -0,0 +1,358 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// HPA*: hierarchical pathfinding over a dense grid. The map is split into
+// square clusters. Wherever two clusters share an open stretch of border,
+// entrance cells are placed on both sides, and every cluster caches the
+// distances between its own entrances. A query then only searches the
+// start and goal clusters cell by cell and runs A* over the entrance graph
+// in between, so its cost grows with the number of clusters instead of the
+// map area.
+//
+// find_path() returns the abstract path: start, the entrances it passes and
+// goal, in start-to-goal order. Consecutive waypoints either share a
+// cluster or are grid neighbors, and refine_segment() expands one of those
+// steps into tiles on demand. Wall edits only mark the touched clusters,
+// which are rebuilt on the next query.
+template<typename Grid>
+struct HierarchicalGrid {
+	typedef typename Grid::Location Location;
+	// f, -g and cell; among equal f the deepest node wins, which keeps A*
+	// from fanning out over the many equal cost routes of a grid
+	typedef tuple<int, int, int> PQElement;
+	enum { INF = INT_MAX / 2 };
+
+	struct Cluster {
+		int x0, y0, x1, y1;
+		vector<int> entrances;
+		// entrance to entrance distances inside the cluster, row major
+		vector<int> distances;
+	};
+
+	Grid grid;
+	int cluster_size;
+	int clusters_x, clusters_y;
+	vector<Cluster> clusters;
+	// per cell, index into its cluster's entrances or -1
+	vector<int> entrance_index;
+	vector<int> dirty;
+	DenseBitset dirty_marked;
+
+	// scratch shared by the cluster searches and the abstract search
+	vector<int> cost;
+	vector<int> parent;
+	vector<unsigned> visited;
+	unsigned generation;
+	vector<PQElement> frontier;
+	// abstract nodes expanded by the last find_path()
+	int expanded;
+
+	HierarchicalGrid(const Grid& grid_, int cluster_size_ = 16)
+		: grid(grid_), cluster_size(cluster_size_),
+		clusters_x((grid_.width + cluster_size_ - 1) / cluster_size_),
+		clusters_y((grid_.height + cluster_size_ - 1) / cluster_size_),
+		clusters(clusters_x * clusters_y), entrance_index(grid_.size(), -1),
+		dirty_marked(clusters_x * clusters_y),
+		cost(grid_.size()), parent(grid_.size()), visited(grid_.size(), 0), generation(0), expanded(0) {
+		for (int c = 0; c < int(clusters.size()); ++c) {
+			Cluster& cluster = clusters[c];
+			cluster.x0 = (c % clusters_x) * cluster_size;
+			cluster.y0 = (c / clusters_x) * cluster_size;
+			cluster.x1 = std::min(cluster.x0 + cluster_size, grid.width);
+			cluster.y1 = std::min(cluster.y0 + cluster_size, grid.height);
+		}
+		for (int c = 0; c < int(clusters.size()); ++c) {
+			build_entrances(c);
+		}
+		for (int c = 0; c < int(clusters.size()); ++c) {
+			build_distances(c);
+		}
+	}
+
+	inline int cluster_of(int index) const {
+		return (index % grid.width) / cluster_size + (index / grid.width) / cluster_size * clusters_x;
+	}
+
+	void set_wall(Location id, bool wall) {
+		if (grid.passable(id) != wall) {
+			return;
+		}
+		if (wall) {
+			grid.add_wall(id);
+		}
+		else {
+			grid.remove_wall(id);
+		}
+		// a cell on a cluster edge also changes the entrances next door
+		int x, y, dx, dy;
+		tie(x, y) = id;
+		mark_dirty(cluster_of(grid.index(id)));
+		for (auto dir : SquareGrid::DIRS) {
+			tie(dx, dy) = dir;
+			Location next(x + dx, y + dy);
+			if (grid.in_bounds(next)) {
+				mark_dirty(cluster_of(grid.index(next)));
+			}
+		}
+	}
+
+	void rebuild_dirty() {
+		for (int c : dirty) {
+			build_entrances(c);
+		}
+		for (int c : dirty) {
+			build_distances(c);
+			dirty_marked.reset(c);
+		}
+		dirty.clear();
+	}
+
+	bool find_path(Location start, Location goal, vector<Location>& waypoints) {
+		waypoints.clear();
+		expanded = 0;
+		rebuild_dirty();
+		if (!grid.passable(start) || !grid.passable(goal)) {
+			return false;
+		}
+		int s = grid.index(start), t = grid.index(goal);
+		int sc = cluster_of(s), gc = cluster_of(t);
+
+		// connect start and goal to the entrances of their clusters
+		local_search(s, sc, false);
+		vector<int> start_costs(clusters[sc].entrances.size());
+		for (size_t i = 0; i < start_costs.size(); ++i) {
+			start_costs[i] = reached(clusters[sc].entrances[i]) ? cost[clusters[sc].entrances[i]] : INF;
+		}
+		int direct = sc == gc && reached(t) ? cost[t] : INF;
+		local_search(t, gc, true);
+		vector<int> goal_costs(clusters[gc].entrances.size());
+		for (size_t i = 0; i < goal_costs.size(); ++i) {
+			goal_costs[i] = reached(clusters[gc].entrances[i]) ? cost[clusters[gc].entrances[i]] : INF;
+		}
+
+		begin_search();
+		relax(s, s, 0, t);
+		while (!frontier.empty()) {
+			int f, current;
+			tie(f, std::ignore, current) = pop();
+			if (f > cost[current] + distance(current, t)) {
+				continue;
+			}
+			if (current == t) {
+				for (int i = t; i != s; i = parent[i]) {
+					waypoints.push_back(grid.location(i));
+				}
+				waypoints.push_back(start);
+				std::reverse(waypoints.begin(), waypoints.end());
+				return true;
+			}
+			++expanded;
+
+			if (current == s) {
+				const Cluster& cluster = clusters[sc];
+				for (size_t i = 0; i < cluster.entrances.size(); ++i) {
+					relax(cluster.entrances[i], s, start_costs[i], t);
+				}
+				relax(t, s, direct, t);
+			}
+			int local = entrance_index[current];
+			if (local < 0) {
+				continue;
+			}
+			int c = cluster_of(current);
+			const Cluster& cluster = clusters[c];
+			int count = int(cluster.entrances.size());
+			for (int j = 0; j < count; ++j) {
+				relax(cluster.entrances[j], current, cost[current] + cluster.distances[local * count + j], t);
+			}
+			Location id = grid.location(current);
+			for (auto next : grid.neighbors(id)) {
+				int n = grid.index(next);
+				if (cluster_of(n) != c && entrance_index[n] >= 0) {
+					relax(n, current, cost[current] + grid.cost(id, next), t);
+				}
+			}
+			if (c == gc) {
+				relax(t, current, cost[current] + goal_costs[local], t);
+			}
+		}
+		return false;
+	}
+
+	// Append the tiles after waypoints[i] up to and including waypoints[i + 1].
+	void refine_segment(const vector<Location>& waypoints, size_t i, vector<Location>& path) {
+		int a = grid.index(waypoints[i]), b = grid.index(waypoints[i + 1]);
+		int c = cluster_of(a);
+		if (c != cluster_of(b)) {
+			path.push_back(waypoints[i + 1]);
+			return;
+		}
+		local_search(a, c, false);
+		size_t first = path.size();
+		for (int j = b; j != a; j = parent[j]) {
+			path.push_back(grid.location(j));
+		}
+		std::reverse(path.begin() + first, path.end());
+	}
+
+	// Fully refined path in start-to-goal order.
+	vector<Location> refine_path(const vector<Location>& waypoints) {
+		vector<Location> path;
+		if (!waypoints.empty()) {
+			path.push_back(waypoints.front());
+			for (size_t i = 0; i + 1 < waypoints.size(); ++i) {
+				refine_segment(waypoints, i, path);
+			}
+		}
+		return path;
+	}
+
+private:
+	inline int distance(int a, int b) const {
+		return abs(a % grid.width - b % grid.width) + abs(a / grid.width - b / grid.width);
+	}
+
+	inline bool reached(int index) const {
+		return visited[index] == generation;
+	}
+
+	void mark_dirty(int c) {
+		if (!dirty_marked.test(c)) {
+			dirty_marked.set(c);
+			dirty.push_back(c);
+		}
+	}
+
+	void begin_search() {
+		if (++generation == 0) {
+			std::fill(visited.begin(), visited.end(), 0);
+			generation = 1;
+		}
+		frontier.clear();
+	}
+
+	inline void push(int priority, int depth, int index) {
+		frontier.emplace_back(priority, -depth, index);
+		std::push_heap(frontier.begin(), frontier.end(), std::greater<PQElement>());
+	}
+
+	inline PQElement pop() {
+		std::pop_heap(frontier.begin(), frontier.end(), std::greater<PQElement>());
+		PQElement top = frontier.back();
+		frontier.pop_back();
+		return top;
+	}
+
+	void relax(int next, int from, int new_cost, int goal) {
+		if (new_cost >= INF) {
+			return;
+		}
+		if (!reached(next) || new_cost < cost[next]) {
+			visited[next] = generation;
+			cost[next] = new_cost;
+			parent[next] = from;
+			push(new_cost + distance(next, goal), new_cost, next);
+		}
+	}
+
+	// Dijkstra from one cell, never leaving cluster c. The reverse search
+	// measures costs towards the source instead of away from it.
+	void local_search(int source, int c, bool reverse) {
+		const Cluster& cluster = clusters[c];
+		begin_search();
+		visited[source] = generation;
+		cost[source] = 0;
+		parent[source] = source;
+		push(0, 0, source);
+		while (!frontier.empty()) {
+			int priority, current;
+			tie(priority, std::ignore, current) = pop();
+			if (priority > cost[current]) {
+				continue;
+			}
+			Location id = grid.location(current);
+			for (auto next : grid.neighbors(id)) {
+				int x, y;
+				tie(x, y) = next;
+				if (x < cluster.x0 || x >= cluster.x1 || y < cluster.y0 || y >= cluster.y1) {
+					continue;
+				}
+				int n = grid.index(next);
+				int new_cost = cost[current] + (reverse ? grid.cost(next, id) : grid.cost(id, next));
+				if (!reached(n) || new_cost < cost[n]) {
+					visited[n] = generation;
+					cost[n] = new_cost;
+					parent[n] = current;
+					push(new_cost, 0, n);
+				}
+			}
+		}
+	}
+
+	// Entrances are placed per maximal open stretch of a shared border: one
+	// in the middle of short stretches, one at each end of long ones. Both
+	// clusters walk the border in the same order and pick the same spots.
+	void build_entrances(int c) {
+		Cluster& cluster = clusters[c];
+		for (int e : cluster.entrances) {
+			entrance_index[e] = -1;
+		}
+		cluster.entrances.clear();
+
+		for (auto dir : SquareGrid::DIRS) {
+			int dx, dy;
+			tie(dx, dy) = dir;
+			int x = dx > 0 ? cluster.x1 - 1 : cluster.x0;
+			int y = dy > 0 ? cluster.y1 - 1 : cluster.y0;
+			if (!grid.in_bounds(Location(x + dx, y + dy))) {
+				continue;
+			}
+			int length = dx != 0 ? cluster.y1 - cluster.y0 : cluster.x1 - cluster.x0;
+			int run = -1;
+			for (int k = 0; k <= length; ++k) {
+				int cx = dx != 0 ? x : cluster.x0 + k;
+				int cy = dx != 0 ? cluster.y0 + k : y;
+				bool open = k < length && grid.passable(Location(cx, cy)) && grid.passable(Location(cx + dx, cy + dy));
+				if (open && run < 0) {
+					run = k;
+				}
+				else if (!open && run >= 0) {
+					int last = k - 1;
+					if (last - run + 1 < 6) {
+						add_entrance(cluster, dx != 0 ? x : cluster.x0 + (run + last) / 2, dx != 0 ? cluster.y0 + (run + last) / 2 : y);
+					}
+					else {
+						add_entrance(cluster, dx != 0 ? x : cluster.x0 + run, dx != 0 ? cluster.y0 + run : y);
+						add_entrance(cluster, dx != 0 ? x : cluster.x0 + last, dx != 0 ? cluster.y0 + last : y);
+					}
+					run = -1;
+				}
+			}
+		}
+		for (size_t i = 0; i < cluster.entrances.size(); ++i) {
+			entrance_index[cluster.entrances[i]] = int(i);
+		}
+	}
+
+	void add_entrance(Cluster& cluster, int x, int y) {
+		int index = y * grid.width + x;
+		if (std::find(cluster.entrances.begin(), cluster.entrances.end(), index) == cluster.entrances.end()) {
+			cluster.entrances.push_back(index);
+		}
+	}
+
+	void build_distances(int c) {
+		Cluster& cluster = clusters[c];
+		int count = int(cluster.entrances.size());
+		cluster.distances.assign(count * count, INF);
+		for (int i = 0; i < count; ++i) {
+			local_search(cluster.entrances[i], c, false);
+			for (int j = 0; j < count; ++j) {
+				if (reached(cluster.entrances[j])) {
+					cluster.distances[i * count + j] = cost[cluster.entrances[j]];
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Sum of the influence of point sources over a grid, e.g. the damage per
+// second towers deal on every cell they reach. Each source covers the
+// cells whose centers lie within its radius of the source's cell, with
+// the same amount on all of them. At most one source stands on a cell, as
+// towers do, so a source is named by its cell.
+//
+// Adding, changing or removing a source only touches the cells under its
+// old and new discs; nothing is summed again over all sources. Amounts are
+// integers, so taking a source away leaves exactly what was there before
+// it, however many changes came in between.
+struct InfluenceMap {
+	typedef tuple<int, int> Location;
+
+	int width, height;
+	// summed amounts per cell, row major
+	vector<int> values;
+
+	InfluenceMap(int width_, int height_)
+		: width(width_), height(height_), values(size_t(width_) * height_, 0) {}
+
+	inline int at(Location id) const {
+		return values[std::get<1>(id) * width + std::get<0>(id)];
+	}
+
+	// Puts a source on center, replacing the one there before. An amount of
+	// 0 just removes it.
+	void set(Location center, float radius, int amount) {
+		int key = std::get<1>(center) * width + std::get<0>(center);
+		auto found = sources.find(key);
+		if (found != sources.end()) {
+			stamp(center, found->second.radius, -found->second.amount);
+			sources.erase(found);
+		}
+		if (amount != 0 && radius >= 0.0f) {
+			Source source = { radius, amount };
+			sources[key] = source;
+			stamp(center, radius, amount);
+		}
+	}
+
+	void clear() {
+		sources.clear();
+		std::fill(values.begin(), values.end(), 0);
+	}
+
+private:
+	struct Source {
+		float radius;
+		int amount;
+	};
+
+	// cell of the source -> source
+	unordered_map<int, Source> sources;
+
+	// Adds amount over the disc, one clipped span per row.
+	void stamp(Location center, float radius, int amount) {
+		int x, y;
+		tie(x, y) = center;
+		int reach = int(radius);
+		float squared = radius * radius;
+		for (int dy = -reach; dy <= reach; ++dy) {
+			if (y + dy < 0 || y + dy >= height) {
+				continue;
+			}
+			int span = int(std::sqrt(squared - float(dy * dy)));
+			int* row = values.data() + (y + dy) * width;
+			for (int cx = std::max(x - span, 0); cx <= std::min(x + span, width - 1); ++cx) {
+				row[cx] += amount;
+			}
+		}
+	}
+};
+
+// DenseGrid whose step cost grows with the influence on the cell entered,
+// one extra step per divisor of influence. Costs never drop below 1, so
+// the Manhattan heuristic stays consistent. Without an influence map, or
+// with a divisor of 0, it costs the same as a DenseGrid.
+struct DenseGridWithInfluence : DenseGrid {
+	const InfluenceMap* influence;
+	int divisor;
+
+	DenseGridWithInfluence(int w, int h) : DenseGrid(w, h), influence(nullptr), divisor(0) {}
+
+	explicit DenseGridWithInfluence(const DenseGrid& grid) : DenseGrid(grid), influence(nullptr), divisor(0) {}
+
+	inline int cost(Location, Location b) const {
+		if (!influence || divisor <= 0) {
+			return 1;
+		}
+		return 1 + std::max(influence->values[index(b)], 0) / divisor;
+	}
+};
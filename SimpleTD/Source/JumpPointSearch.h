@@ -0,0 +1,241 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// Jump Point Search for uniform cost, 4-connected dense grids. Straight
+// runs without forced neighbors are skipped in one jump, so only jump
+// points ever reach the priority queue. Returns paths of the same length
+// as a_star_search, in the same goal-to-start order as reconstruct_path.
+//
+// Horizontal moves stop at forced neighbors. Vertical moves also stop
+// wherever a horizontal jump would find something, which is what keeps the
+// search optimal without diagonal moves.
+//
+// After precompute() the search runs as JPS+: jump distances for every
+// cell and direction come from a table instead of scanning the grid. The
+// table has to be rebuilt with precompute() whenever walls change.
+struct JumpPointSearch {
+	typedef DenseGrid::Location Location;
+	typedef pair<int, int> PQElement;
+
+	const DenseGrid& grid;
+	// JPS+ table, four entries per cell in SquareGrid::DIRS order. A positive
+	// entry is the distance to the next jump point, otherwise minus the
+	// number of free cells before the next wall.
+	vector<int> jump_distances;
+	vector<int> parent;
+	vector<int> cost;
+	vector<unsigned> visited;
+	unsigned generation;
+	priority_queue<PQElement, vector<PQElement>, std::greater<PQElement> > frontier;
+	// statistics of the last search
+	int expanded;
+	int pushed;
+
+	explicit JumpPointSearch(const DenseGrid& grid_)
+		: grid(grid_), parent(grid_.size()), cost(grid_.size()), visited(grid_.size(), 0),
+		generation(0), expanded(0), pushed(0) {}
+
+	inline bool walkable(int x, int y) const {
+		return 0 <= x && x < grid.width && 0 <= y && y < grid.height && grid.walkable.test(y * grid.width + x);
+	}
+
+	inline bool forced_horizontal(int x, int y, int dx) const {
+		return (walkable(x, y - 1) && !walkable(x - dx, y - 1)) || (walkable(x, y + 1) && !walkable(x - dx, y + 1));
+	}
+
+	inline bool forced_vertical(int x, int y, int dy) const {
+		return (walkable(x - 1, y) && !walkable(x - 1, y - dy)) || (walkable(x + 1, y) && !walkable(x + 1, y - dy));
+	}
+
+	void precompute() {
+		int width = grid.width, height = grid.height;
+		jump_distances.assign(size_t(grid.size()) * 4, 0);
+
+		for (int y = 0; y < height; ++y) {
+			for (int x = width - 2; x >= 0; --x) {
+				jump_distances[(y * width + x) * 4 + 0] = next_distance(x + 1, y, 0, forced_horizontal(x + 1, y, 1));
+			}
+			for (int x = 1; x < width; ++x) {
+				jump_distances[(y * width + x) * 4 + 2] = next_distance(x - 1, y, 2, forced_horizontal(x - 1, y, -1));
+			}
+		}
+		// vertical runs also stop where a horizontal jump finds a jump point
+		for (int x = 0; x < width; ++x) {
+			for (int y = 1; y < height; ++y) {
+				jump_distances[(y * width + x) * 4 + 1] = next_distance(x, y - 1, 1, stops_vertical(x, y - 1, -1));
+			}
+			for (int y = height - 2; y >= 0; --y) {
+				jump_distances[(y * width + x) * 4 + 3] = next_distance(x, y + 1, 3, stops_vertical(x, y + 1, 1));
+			}
+		}
+	}
+
+	bool search(Location start, Location goal, vector<Location>& path) {
+		path.clear();
+		expanded = 0;
+		pushed = 0;
+		if (!grid.passable(start) || !grid.passable(goal)) {
+			return false;
+		}
+		if (++generation == 0) {
+			std::fill(visited.begin(), visited.end(), 0);
+			generation = 1;
+		}
+		while (!frontier.empty()) {
+			frontier.pop();
+		}
+
+		int s = grid.index(start), t = grid.index(goal);
+		parent[s] = s;
+		cost[s] = 0;
+		visited[s] = generation;
+		frontier.emplace(heuristic(start, goal), s);
+
+		while (!frontier.empty()) {
+			PQElement top = frontier.top();
+			frontier.pop();
+			int current = top.second;
+			if (top.first > cost[current] + distance(current, t)) {
+				continue;
+			}
+			if (current == t) {
+				reconstruct(s, t, path);
+				return true;
+			}
+			++expanded;
+
+			int x = current % grid.width, y = current / grid.width;
+			int px = parent[current] % grid.width, py = parent[current] / grid.width;
+			int dx = (x > px) - (x < px), dy = (y > py) - (y < py);
+
+			for (int dir = 0; dir < 4; ++dir) {
+				int ddx, ddy;
+				tie(ddx, ddy) = SquareGrid::DIRS[dir];
+				// never turn back towards the parent
+				if ((dx != 0 || dy != 0) && ddx == -dx && ddy == -dy) {
+					continue;
+				}
+				int next;
+				if (!jump(x, y, dir, t, next)) {
+					continue;
+				}
+				int new_cost = cost[current] + distance(current, next);
+				if (visited[next] != generation || new_cost < cost[next]) {
+					visited[next] = generation;
+					cost[next] = new_cost;
+					parent[next] = current;
+					frontier.emplace(new_cost + distance(next, t), next);
+					++pushed;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	inline int distance(int a, int b) const {
+		return abs(a % grid.width - b % grid.width) + abs(a / grid.width - b / grid.width);
+	}
+
+	// Table entry for the cell before (x, y), looking in direction dir.
+	int next_distance(int x, int y, int dir, bool stop) const {
+		if (!walkable(x, y)) {
+			return 0;
+		}
+		if (stop) {
+			return 1;
+		}
+		int previous = jump_distances[(y * grid.width + x) * 4 + dir];
+		return previous > 0 ? previous + 1 : previous - 1;
+	}
+
+	bool stops_vertical(int x, int y, int dy) const {
+		int i = (y * grid.width + x) * 4;
+		return forced_vertical(x, y, dy) || jump_distances[i + 0] > 0 || jump_distances[i + 2] > 0;
+	}
+
+	bool jump(int x, int y, int dir, int goal, int& next) const {
+		int dx, dy;
+		tie(dx, dy) = SquareGrid::DIRS[dir];
+		if (jump_distances.empty()) {
+			return dx != 0 ? scan_horizontal(x, y, dx, goal, next) : scan_vertical(x, y, dy, goal, next);
+		}
+
+		int tx = goal % grid.width, ty = goal / grid.width;
+		int steps = jump_distances[(y * grid.width + x) * 4 + dir];
+		int reach = abs(steps);
+		if (dx != 0) {
+			int k = (tx - x) * dx;
+			if (ty == y && k >= 1 && k <= reach) {
+				next = goal;
+				return true;
+			}
+		}
+		else {
+			int k = (ty - y) * dy;
+			if (k >= 1 && k <= reach) {
+				// the run passes the goal row; stop there if the goal is in sight
+				int row = (ty * grid.width + x) * 4;
+				int side = tx > x ? jump_distances[row + 0] : jump_distances[row + 2];
+				if (abs(tx - x) <= abs(side)) {
+					next = ty * grid.width + x;
+					return true;
+				}
+			}
+		}
+		if (steps > 0) {
+			next = (y + dy * steps) * grid.width + x + dx * steps;
+			return true;
+		}
+		return false;
+	}
+
+	bool scan_horizontal(int x, int y, int dx, int goal, int& next) const {
+		for (;;) {
+			x += dx;
+			if (!walkable(x, y)) {
+				return false;
+			}
+			int i = y * grid.width + x;
+			if (i == goal || forced_horizontal(x, y, dx)) {
+				next = i;
+				return true;
+			}
+		}
+	}
+
+	bool scan_vertical(int x, int y, int dy, int goal, int& next) const {
+		int ignored;
+		for (;;) {
+			y += dy;
+			if (!walkable(x, y)) {
+				return false;
+			}
+			int i = y * grid.width + x;
+			if (i == goal || forced_vertical(x, y, dy) ||
+				scan_horizontal(x, y, 1, goal, ignored) || scan_horizontal(x, y, -1, goal, ignored)) {
+				next = i;
+				return true;
+			}
+		}
+	}
+
+	// Expand the jump point chain into one location per tile.
+	void reconstruct(int start, int goal, vector<Location>& path) const {
+		int current = goal;
+		path.push_back(grid.location(current));
+		while (current != start) {
+			int previous = parent[current];
+			int x = current % grid.width, y = current / grid.width;
+			int px = previous % grid.width, py = previous / grid.width;
+			int dx = (px > x) - (px < x), dy = (py > y) - (py < y);
+			while (x != px || y != py) {
+				x += dx;
+				y += dy;
+				path.push_back(Location(x, y));
+			}
+			current = previous;
+		}
+	}
+};
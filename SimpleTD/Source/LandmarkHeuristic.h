@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// ALT heuristic (A*, landmarks, triangle inequality). For a few landmark
+// cells L the exact costs d(L, x) and d(x, L) to and from every cell are
+// computed once per map. The triangle inequality then gives two lower
+// bounds on any d(a, b):
+//
+//   d(a, b) >= d(L, b) - d(L, a)
+//   d(a, b) >= d(a, L) - d(b, L)
+//
+// Both directions are needed because step costs are not symmetric: moving
+// into a forest costs more than moving out of it. The estimate is the
+// largest bound over all landmarks and the graph's own heuristic, which
+// stays consistent, so it works with every frontier. On maps full of
+// forests it is far tighter than the Manhattan distance.
+//
+// Works on graphs with dense ids (size(), index(), location()) where every
+// edge can be walked back, which holds for all the grids. The tables go
+// stale when walls change; call rebuild() after editing the map.
+template<typename Graph>
+struct LandmarkHeuristic {
+	typedef typename Graph::Location Location;
+	enum { INF = INT_MAX / 2 };
+
+	const Graph& graph;
+	vector<Location> landmarks;
+	// d(L, x) and d(x, L) for every landmark, grouped by cell x so one
+	// estimate reads two short runs of memory
+	vector<int> distances;
+
+	LandmarkHeuristic(const Graph& graph_, const vector<Location>& landmarks_)
+		: graph(graph_), landmarks(landmarks_) {
+		rebuild();
+	}
+
+	// Spreads count landmarks over the part of the map reachable from seed:
+	// each new one is the cell farthest from those already chosen, which
+	// puts them on the map border behind the cells they have to bound.
+	LandmarkHeuristic(const Graph& graph_, Location seed, int count)
+		: graph(graph_) {
+		vector<int> field, nearest(graph.size(), INF);
+		search(graph.index(seed), false, field);
+		for (int k = 0; k < count; ++k) {
+			int best = -1;
+			for (int i = 0; i < graph.size(); ++i) {
+				if (field[i] < INF) {
+					// the seed only places the first landmark
+					nearest[i] = k <= 1 ? field[i] : std::min(nearest[i], field[i]);
+					if (nearest[i] > 0 && (best < 0 || nearest[i] > nearest[best])) {
+						best = i;
+					}
+				}
+			}
+			if (best < 0) {
+				break;
+			}
+			landmarks.push_back(graph.location(best));
+			search(best, false, field);
+		}
+		rebuild();
+	}
+
+	// Recomputes the tables for the current map.
+	void rebuild() {
+		int count = int(landmarks.size());
+		distances.assign(size_t(graph.size()) * count * 2, INF);
+		vector<int> field;
+		for (int k = 0; k < count; ++k) {
+			for (int backward = 0; backward < 2; ++backward) {
+				search(graph.index(landmarks[k]), backward != 0, field);
+				for (int i = 0; i < graph.size(); ++i) {
+					distances[(size_t(i) * count + k) * 2 + backward] = field[i];
+				}
+			}
+		}
+	}
+
+	inline int operator()(Location a, Location b) const {
+		int count = int(landmarks.size());
+		const int* from = distances.data() + size_t(graph.index(a)) * count * 2;
+		const int* to = distances.data() + size_t(graph.index(b)) * count * 2;
+		int bound = heuristic(graph, a, b);
+		for (int k = 0; k < count * 2; k += 2) {
+			if (from[k] < INF && to[k] < INF) {
+				bound = std::max(bound, to[k] - from[k]);
+			}
+			if (from[k + 1] < INF && to[k + 1] < INF) {
+				bound = std::max(bound, from[k + 1] - to[k + 1]);
+			}
+		}
+		return bound;
+	}
+
+private:
+	// Dijkstra over the whole graph from root, or with backward set, the
+	// cost of reaching root from every cell.
+	void search(int root, bool backward, vector<int>& field) const {
+		field.assign(graph.size(), INF);
+		BucketQueue<int> frontier;
+		field[root] = 0;
+		frontier.put(root, 0);
+
+		while (!frontier.empty()) {
+			int current = frontier.get();
+			Location id = graph.location(current);
+			for_each_edge(graph, id, [&](Location next, int step) {
+				int n = graph.index(next);
+				int new_cost = field[current] + (backward ? graph.cost(next, id) : step);
+				if (new_cost < field[n]) {
+					field[n] = new_cost;
+					frontier.put(n, new_cost);
+				}
+			});
+		}
+	}
+};
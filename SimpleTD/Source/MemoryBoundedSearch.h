@@ -0,0 +1,266 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+// IDA* for maps too large to keep per-cell search state in memory. A* and
+// the workspaces keep a came_from and cost_so_far entry for every cell
+// they touch; IDA* keeps only the current path, and runs depth first
+// searches bounded by f = g + h, raising the bound to the smallest f that
+// went over it until the goal comes within reach. It finds the same
+// optimal cost as A* with the same consistent heuristic.
+//
+// Plain IDA* walks the many equal-cost routes of a grid over and over, so
+// a transposition table remembers the best g per cell within the current
+// iteration and cuts the walks that arrive no cheaper. The table is an
+// open addressing array of a fixed size chosen up front; once it is three
+// quarters full, and always before the last slot, new cells are not
+// remembered and the search simply gets slower, so memory never grows past
+// the table plus the path. peak_bytes reports what the last search held,
+// to size the table for a device.
+//
+// A table much smaller than the area searched costs time exponentially,
+// worst of all proving a goal unreachable; expansion_limit caps the work.
+template<typename Graph>
+struct IDAStarWorkspace {
+	typedef typename Graph::Location Location;
+	enum { INF = INT_MAX / 2 };
+
+	// goal to start, like reconstruct_path; empty when not found
+	vector<Location> path;
+	int cost;
+	// bound raises, i.e. depth first passes, of the last search
+	int iterations;
+	// bytes of search state held at once by the last search
+	size_t peak_bytes;
+	// cells expanded by the last search, and the most allowed, 0 for no limit
+	long long expansions;
+	long long expansion_limit;
+
+	// table_entries is rounded up to a power of two; 0 turns the table off
+	explicit IDAStarWorkspace(size_t table_entries = 1 << 16)
+		: cost(-1), iterations(0), peak_bytes(0), expansions(0), expansion_limit(0), iteration(0), live(0) {
+		size_t capacity = 1;
+		while (capacity < table_entries) {
+			capacity *= 2;
+		}
+		table.resize(table_entries > 0 ? capacity : 0);
+	}
+
+	inline size_t table_capacity() const {
+		return table.size();
+	}
+
+	// Whether index was reached for at most g in this iteration.
+	bool reached(int index, int g) const {
+		if (table.empty()) {
+			return false;
+		}
+		size_t mask = table.size() - 1;
+		for (size_t slot = (size_t(unsigned(index)) * 2654435769u) & mask;; slot = (slot + 1) & mask) {
+			const Entry& entry = table[slot];
+			if (entry.iteration != iteration) {
+				return false;
+			}
+			if (entry.index == index) {
+				return entry.g <= g;
+			}
+		}
+	}
+
+	// Remembers g for index in this iteration. Returns false when the cell
+	// was already reached as cheaply, so this walk can stop.
+	bool improve(int index, int g) {
+		if (table.empty()) {
+			return true;
+		}
+		size_t mask = table.size() - 1;
+		// an odd multiplier scatters neighboring ids over the table
+		for (size_t slot = (size_t(unsigned(index)) * 2654435769u) & mask;; slot = (slot + 1) & mask) {
+			Entry& entry = table[slot];
+			// live entries of an iteration never have a stale or empty slot
+			// before them on their probe run, so the first one ends the run
+			if (entry.iteration != iteration) {
+				// a slot always stays empty so probes for absent cells end
+				if ((live + 1) * 4 <= table.size() * 3) {
+					entry.index = index;
+					entry.g = g;
+					entry.iteration = iteration;
+					++live;
+				}
+				return true;
+			}
+			if (entry.index == index) {
+				if (entry.g <= g) {
+					return false;
+				}
+				entry.g = g;
+				return true;
+			}
+		}
+	}
+
+	void next_iteration() {
+		if (++iteration == 0) {
+			std::fill(table.begin(), table.end(), Entry());
+			iteration = 1;
+		}
+		live = 0;
+	}
+
+	struct Frame {
+		int index, g;
+		// the cell's untried edges are edges[edges_begin...]
+		size_t edges_begin;
+	};
+
+	struct Edge {
+		int index, cost;
+		// cost plus the estimate from index to the goal
+		int estimate;
+	};
+
+	vector<Frame> frames;
+	vector<Edge> edges;
+
+private:
+	struct Entry {
+		int index, g;
+		// 0 is never a live iteration
+		unsigned iteration;
+		Entry() : index(-1), g(0), iteration(0) {}
+	};
+
+	vector<Entry> table;
+	unsigned iteration;
+	size_t live;
+};
+
+// Pushes the edges out of id, best estimate last, so the depth first pass
+// tries the most promising cell first. Reaching cells cheaply early lets
+// the table cut the dearer walks that follow.
+template<typename Graph, typename Heuristic>
+void push_edges(const Graph& graph, typename Graph::Location id, typename Graph::Location goal,
+	const Heuristic& estimate, vector<typename IDAStarWorkspace<Graph>::Edge>& edges) {
+	typedef typename Graph::Location Location;
+	typedef typename IDAStarWorkspace<Graph>::Edge Edge;
+	size_t begin = edges.size();
+	for_each_edge(graph, id, [&](Location next, int cost) {
+		Edge edge = { graph.index(next), cost, cost + estimate(next, goal) };
+		edges.push_back(edge);
+	});
+	// insertion sort, the runs are a handful of edges long
+	for (size_t i = begin + 1; i < edges.size(); ++i) {
+		for (size_t j = i; j > begin && edges[j - 1].estimate < edges[j].estimate; --j) {
+			std::swap(edges[j - 1], edges[j]);
+		}
+	}
+}
+
+template<typename Graph, typename Heuristic>
+bool ida_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+IDAStarWorkspace<Graph>& workspace,
+const Heuristic& estimate)
+{
+	typedef typename Graph::Location Location;
+	typedef typename IDAStarWorkspace<Graph>::Frame Frame;
+	enum { INF = IDAStarWorkspace<Graph>::INF };
+
+	workspace.path.clear();
+	workspace.cost = -1;
+	workspace.iterations = 0;
+	workspace.peak_bytes = 0;
+	workspace.expansions = 0;
+	vector<Frame>& frames = workspace.frames;
+	typedef typename IDAStarWorkspace<Graph>::Edge Edge;
+	vector<Edge>& edges = workspace.edges;
+	int s = graph.index(start), g = graph.index(goal);
+	if (s == g) {
+		workspace.path.push_back(goal);
+		workspace.cost = 0;
+		return true;
+	}
+	size_t table_bytes = workspace.table_capacity() * (2 * sizeof(int) + sizeof(unsigned));
+
+	// An unreachable goal shows as an iteration that finds no new cell to
+	// raise the bound for. A full table cannot tell new cells from old, so
+	// the bound also stops where no path without repeated cells can reach:
+	// every cell once at the dearest step seen.
+	int max_step = 1;
+	int bound = estimate(start, goal);
+	while (bound < INF && (long long)(bound) <= (long long)(graph.size()) * max_step) {
+		++workspace.iterations;
+		workspace.next_iteration();
+		workspace.improve(s, 0);
+		int next_bound = INF;
+		frames.clear();
+		edges.clear();
+		Frame root = { s, 0, 0 };
+		frames.push_back(root);
+		push_edges(graph, start, goal, estimate, edges);
+
+		while (!frames.empty()) {
+			Frame frame = frames.back();
+			if (edges.size() == frame.edges_begin) {
+				frames.pop_back();
+				continue;
+			}
+			Edge edge = edges.back();
+			edges.pop_back();
+			int n = edge.index;
+			int new_cost = frame.g + edge.cost;
+			max_step = std::max(max_step, edge.cost);
+			// never straight back where we came from
+			if (frames.size() > 1 && n == frames[frames.size() - 2].index) {
+				continue;
+			}
+			Location next = graph.location(n);
+			int f = frame.g + edge.estimate;
+			if (f > bound) {
+				// a cell already reached as cheaply cannot bring the goal closer
+				if (!workspace.reached(n, new_cost)) {
+					next_bound = std::min(next_bound, f);
+				}
+				continue;
+			}
+			if (!workspace.improve(n, new_cost)) {
+				continue;
+			}
+			if (n == g) {
+				workspace.cost = new_cost;
+				workspace.path.push_back(goal);
+				for (size_t i = frames.size(); i-- > 0;) {
+					workspace.path.push_back(graph.location(frames[i].index));
+				}
+				workspace.peak_bytes = std::max(workspace.peak_bytes,
+					table_bytes + frames.capacity() * sizeof(Frame) + edges.capacity() * sizeof(Edge));
+				return true;
+			}
+			if (++workspace.expansions == workspace.expansion_limit) {
+				workspace.peak_bytes = std::max(workspace.peak_bytes,
+					table_bytes + frames.capacity() * sizeof(Frame) + edges.capacity() * sizeof(Edge));
+				return false;
+			}
+			Frame child = { n, new_cost, edges.size() };
+			frames.push_back(child);
+			push_edges(graph, next, goal, estimate, edges);
+		}
+
+		workspace.peak_bytes = std::max(workspace.peak_bytes,
+			table_bytes + frames.capacity() * sizeof(Frame) + edges.capacity() * sizeof(Edge));
+		bound = next_bound;
+	}
+	return false;
+}
+
+template<typename Graph>
+bool ida_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+IDAStarWorkspace<Graph>& workspace)
+{
+	return ida_star_search(graph, start, goal, workspace, GraphHeuristic<Graph>(graph));
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Many point-to-point queries answered at once, e.g. every spawn and goal
+// pair of a level. The queries are cut into jobs of a few queries each and
+// handed to a dispatcher, which runs them on its worker threads. Every
+// worker searches with its own SearchWorkspace, so the workers share
+// nothing but the read-only graph, and results[i] always answers
+// queries[i], whichever thread ran it.
+//
+// A dispatcher provides workers(), the number of distinct worker numbers
+// it uses, and run(jobs, job), which calls job(j, worker) once for every
+// j < jobs and returns when all are done. Calls running at the same time
+// must have different worker numbers. PathThreadPool below is one; the
+// game hands the jobs to the engine's WorkQueue instead.
+
+// Runs jobs on threads kept alive between batches. The calling thread
+// takes jobs too, as worker 0.
+struct PathThreadPool {
+	// count = 0 uses one thread per hardware core
+	explicit PathThreadPool(int count = 0)
+		: job(nullptr), job_count(0), next_job(0), batch(0), busy(0), stopping(false) {
+		if (count <= 0) {
+			count = std::max(1, int(std::thread::hardware_concurrency()));
+		}
+		for (int worker = 1; worker < count; ++worker) {
+			threads.emplace_back([this, worker] { work(worker); });
+		}
+	}
+
+	~PathThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	inline int workers() const {
+		return int(threads.size()) + 1;
+	}
+
+	void run(int jobs, const std::function<void(int, int)>& job_) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &job_;
+			job_count = jobs;
+			next_job = 0;
+			busy = int(threads.size());
+			++batch;
+		}
+		wake.notify_all();
+		take_jobs(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busy == 0; });
+	}
+
+private:
+	// every thread but the caller's
+	vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)>* job;
+	int job_count;
+	std::atomic<int> next_job;
+	// bumped for every run(), so each thread joins each batch exactly once
+	unsigned batch;
+	// threads still working on the current batch
+	int busy;
+	bool stopping;
+
+	void work(int worker) {
+		unsigned seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || batch != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = batch;
+			}
+			take_jobs(worker);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0) {
+				done.notify_one();
+			}
+		}
+	}
+
+	void take_jobs(int worker) {
+		for (int j = next_job++; j < job_count; j = next_job++) {
+			(*job)(j, worker);
+		}
+	}
+};
+
+template<typename Graph, typename Frontier = BucketQueue<int> >
+struct BatchPathfinder {
+	typedef typename Graph::Location Location;
+	typedef pair<Location, Location> Query;
+	typedef SearchWorkspace<Graph, Frontier> Workspace;
+
+	struct Result {
+		bool found;
+		int cost;
+		// goal-to-start, like reconstruct_path; empty when not found
+		vector<Location> path;
+	};
+
+	// Small jobs even out queries of very different length between
+	// workers; larger ones cost less to dispatch.
+	enum { QUERIES_PER_JOB = 8 };
+
+	const Graph& graph;
+	// one per worker number, made on first use and kept between batches
+	vector<std::unique_ptr<Workspace> > workspaces;
+
+	explicit BatchPathfinder(const Graph& graph_) : graph(graph_) {}
+
+	// Answers every query with a_star_search. The graph must not change
+	// until this returns.
+	template<typename Dispatch>
+	void solve(const vector<Query>& queries, vector<Result>& results, Dispatch& dispatch) {
+		if (workspaces.size() < size_t(dispatch.workers())) {
+			workspaces.resize(dispatch.workers());
+		}
+		results.resize(queries.size());
+		int jobs = int((queries.size() + QUERIES_PER_JOB - 1) / QUERIES_PER_JOB);
+		dispatch.run(jobs, [&](int job, int worker) {
+			std::unique_ptr<Workspace>& workspace = workspaces[worker];
+			if (!workspace) {
+				workspace.reset(new Workspace(graph));
+			}
+			size_t end = std::min(queries.size(), size_t(job + 1) * QUERIES_PER_JOB);
+			for (size_t i = size_t(job) * QUERIES_PER_JOB; i < end; ++i) {
+				solve_one(queries[i], results[i], *workspace);
+			}
+		});
+	}
+
+private:
+	void solve_one(const Query& query, Result& result, Workspace& workspace) const {
+		result.found = a_star_search(graph, query.first, query.second, workspace);
+		if (result.found) {
+			const vector<Location>& path = workspace.reconstruct_path(graph, query.first, query.second);
+			result.cost = workspace.cost_so_far[graph.index(query.second)];
+			result.path.assign(path.begin(), path.end());
+		}
+		else {
+			result.cost = -1;
+			result.path.clear();
+		}
+	}
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Pathfinding.h"
+
+#include <list>
+#include <memory>
+
+// Finished paths keyed by (start, goal, grid revision). DenseGrid bumps its
+// revision on every wall edit, so the first lookup after an edit misses and
+// plans again. Entries of older revisions are never hit again; they sink to
+// the cold end of the LRU list and are the first to go once the cache is
+// over its memory cap.
+//
+// Paths are shared, immutable buffers: everyone walking between the same
+// two cells holds the same one, and a buffer stays valid for its holders
+// after the cache has dropped it.
+template<typename Graph, typename Frontier = BucketQueue<int> >
+struct PathCache {
+	typedef typename Graph::Location Location;
+	// goal-to-start, like reconstruct_path; empty when goal cannot be reached
+	typedef std::shared_ptr<const vector<Location> > Path;
+
+	struct Stats {
+		long long hits;
+		long long misses;
+		long long evictions;
+	};
+
+	const Graph& graph;
+	// approximate heap use, entries and bookkeeping included
+	size_t max_bytes;
+	size_t bytes;
+	Stats stats;
+
+	PathCache(const Graph& graph_, size_t max_bytes_)
+		: graph(graph_), max_bytes(max_bytes_), bytes(0), workspace(graph_) {
+		reset_stats();
+	}
+
+	Path find(Location start, Location goal) {
+		Key key = { graph.index(start), graph.index(goal), graph.revision };
+		auto found = index.find(key);
+		if (found != index.end()) {
+			++stats.hits;
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->path;
+		}
+
+		++stats.misses;
+		std::shared_ptr<vector<Location> > path = std::make_shared<vector<Location> >();
+		if (a_star_search(graph, start, goal, workspace)) {
+			const vector<Location>& found_path = workspace.reconstruct_path(graph, start, goal);
+			path->assign(found_path.begin(), found_path.end());
+		}
+		Entry entry = { key, path, entry_bytes(*path) };
+		entries.push_front(entry);
+		index[key] = entries.begin();
+		bytes += entry.bytes;
+
+		// the new entry stays even when it alone is over the cap
+		while (bytes > max_bytes && entries.size() > 1) {
+			bytes -= entries.back().bytes;
+			index.erase(entries.back().key);
+			entries.pop_back();
+			++stats.evictions;
+		}
+		return path;
+	}
+
+	void clear() {
+		entries.clear();
+		index.clear();
+		bytes = 0;
+	}
+
+	inline size_t size() const {
+		return entries.size();
+	}
+
+	inline double hit_rate() const {
+		long long lookups = stats.hits + stats.misses;
+		return lookups > 0 ? double(stats.hits) / lookups : 0.0;
+	}
+
+	void reset_stats() {
+		stats.hits = 0;
+		stats.misses = 0;
+		stats.evictions = 0;
+	}
+
+private:
+	struct Key {
+		int start;
+		int goal;
+		unsigned revision;
+
+		inline bool operator==(const Key& other) const {
+			return start == other.start && goal == other.goal && revision == other.revision;
+		}
+	};
+
+	struct KeyHash {
+		inline size_t operator()(const Key& key) const {
+			return (size_t(key.start) * 73856093u) ^ (size_t(key.goal) * 19349663u) ^ (size_t(key.revision) * 83492791u);
+		}
+	};
+
+	struct Entry {
+		Key key;
+		Path path;
+		size_t bytes;
+	};
+
+	// most recently used first
+	typedef std::list<Entry> Entries;
+	Entries entries;
+	unordered_map<Key, typename Entries::iterator, KeyHash> index;
+	SearchWorkspace<Graph, Frontier> workspace;
+
+	static size_t entry_bytes(const vector<Location>& path) {
+		// list node, hash node and shared_ptr control block, roughly
+		return sizeof(Entry) + 4 * sizeof(void*) + sizeof(Key) + sizeof(typename Entries::iterator) +
+			4 * sizeof(void*) + sizeof(vector<Location>) + path.capacity() * sizeof(Location);
+	}
+};
@@ -0,0 +1,164 @@
+#include "PathRequestService.h"
+#include "CoreEvents.h"
+#include "Context.h"
+#include "Timer.h"
+#include "Pathfinding.h"
+#include "PathRequests.h"
+#include "AnyAnglePath.h"
+#include "InfluenceMap.h"
+
+/// Threat amounts are kept in hundredths of a damage per second.
+static const float THREAT_UNITS = 100.0f;
+
+PathRequestService::PathRequestService(Context* context) : Object(context),
+grid_(NULL),
+requests_(NULL),
+components_(NULL),
+threat_(NULL),
+budget_(1000),
+anyAngle_(false),
+threatCost_(0.0f)
+{
+	SubscribeToEvent(E_UPDATE, HANDLER(PathRequestService, HandleUpdate));
+}
+
+PathRequestService::~PathRequestService()
+{
+	delete requests_;
+	delete components_;
+	delete grid_;
+	delete threat_;
+}
+
+void PathRequestService::SetGrid(const DenseGrid& grid, const TileMapInfo2D& info)
+{
+	delete requests_;
+	delete components_;
+	delete grid_;
+	delete threat_;
+	grid_ = new DenseGridWithInfluence(grid);
+	threat_ = new InfluenceMap(grid.width, grid.height);
+	grid_->influence = threat_;
+	components_ = new ComponentLabels<DenseGridWithInfluence>(*grid_);
+	requests_ = new PathRequestQueue<DenseGridWithInfluence>(*grid_);
+	requests_->components = components_;
+	info_ = info;
+	SetThreatCost(threatCost_);
+}
+
+void PathRequestService::SetThreatCost(float cost)
+{
+	threatCost_ = std::max(cost, 0.0f);
+	if (!grid_)
+		return;
+
+	// one extra step per divisor hundredths of damage per second
+	grid_->divisor = threatCost_ > 0.0f ? std::max(int(THREAT_UNITS / threatCost_), 1) : 0;
+	++grid_->revision;
+}
+
+void PathRequestService::SetThreat(const IntVector2& tile, float range, float damagePerSecond)
+{
+	DenseGrid::Location id{ tile.x_, tile.y_ };
+	if (!grid_ || !grid_->in_bounds(id))
+		return;
+
+	threat_->set(id, range, int(damagePerSecond * THREAT_UNITS));
+	if (grid_->divisor > 0)
+		++grid_->revision;
+}
+
+void PathRequestService::SetWalkable(const IntVector2& tile, bool walkable)
+{
+	DenseGrid::Location id{ tile.x_, tile.y_ };
+	if (!grid_ || !grid_->in_bounds(id))
+		return;
+
+	if (walkable)
+	{
+		grid_->remove_wall(id);
+		components_->wall_removed(id);
+	}
+	else
+	{
+		grid_->add_wall(id);
+		components_->wall_added(id);
+	}
+}
+
+unsigned PathRequestService::RequestPath(const IntVector2& start, const IntVector2& goal)
+{
+	if (!grid_)
+		return 0;
+
+	return requests_->request(DenseGrid::Location{ start.x_, start.y_ }, DenseGrid::Location{ goal.x_, goal.y_ });
+}
+
+void PathRequestService::CancelPath(unsigned handle)
+{
+	if (requests_)
+		requests_->cancel(handle);
+}
+
+bool PathRequestService::IsPending(unsigned handle) const
+{
+	if (!requests_)
+		return false;
+
+	PathRequestQueue<DenseGridWithInfluence>::Status status = requests_->status(handle);
+	return status == PathRequestQueue<DenseGridWithInfluence>::QUEUED || status == PathRequestQueue<DenseGridWithInfluence>::RUNNING;
+}
+
+bool PathRequestService::HasLineOfSight(const IntVector2& from, const IntVector2& to) const
+{
+	DenseGrid::Location a{ from.x_, from.y_ }, b{ to.x_, to.y_ };
+	if (!grid_ || !grid_->in_bounds(a) || !grid_->in_bounds(b))
+		return false;
+
+	return line_of_sight(*grid_, a, b);
+}
+
+bool PathRequestService::TakePath(unsigned handle, Vector<Vector2>& path, PODVector<IntVector2>* tiles)
+{
+	vector<DenseGridWithInfluence::Location> found;
+	if (!requests_ || !requests_->take(handle, found))
+		return false;
+
+	// shortcuts ignore step costs, so they would cut back across the defended tiles
+	if (anyAngle_ && grid_->divisor == 0)
+		smooth_path(*grid_, found);
+
+	// the queue hands out goal-to-start
+	path.Clear();
+	if (tiles)
+		tiles->Clear();
+	for (int i = int(found.size()) - 1; i >= 0; --i)
+	{
+		int x, y;
+		tie(x, y) = found[i];
+		path.Push(info_.TileIndexToPosition(x, y));
+		if (tiles)
+			tiles->Push(IntVector2(x, y));
+	}
+	return true;
+}
+
+void PathRequestService::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	if (!requests_ || !requests_->pending())
+		return;
+
+	HiresTimer timer;
+	unsigned budget = budget_;
+	requests_->update([&timer, budget]() { return timer.GetUSec(false) >= budget; });
+
+	using namespace PathCompleted;
+	for (unsigned i = 0; i < requests_->completed.size(); ++i)
+	{
+		unsigned handle = requests_->completed[i];
+		VariantMap& data = GetEventDataMap();
+		data[P_HANDLE] = handle;
+		data[P_FOUND] = requests_->status(handle) == PathRequestQueue<DenseGridWithInfluence>::FOUND;
+		SendEvent(E_PATHCOMPLETED, data);
+	}
+}
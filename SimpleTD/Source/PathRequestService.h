@@ -0,0 +1,88 @@
+#pragma once
+#include "Object.h"
+#include "Vector.h"
+#include "Vector2.h"
+#include "TileMapDefs2D.h"
+
+struct DenseGrid;
+struct DenseGridWithInfluence;
+struct InfluenceMap;
+template<typename T> struct BucketQueue;
+template<typename Graph, typename Frontier> struct PathRequestQueue;
+template<typename Graph> struct ComponentLabels;
+
+namespace Urho3D
+{
+
+	/// Path request finished.
+	EVENT(E_PATHCOMPLETED, PathCompleted)
+	{
+		PARAM(P_HANDLE, Handle);                // unsigned
+		PARAM(P_FOUND, Found);                // bool
+	}
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Answers path requests in the background of the frame loop. Each update spends at most the
+/// time budget on the queued searches and continues next frame where it stopped, so re-planning
+/// on a large map never stalls a frame. A finished request sends E_PATHCOMPLETED; until then the
+/// requester keeps whatever route it had. Requests between tiles that are walled off from each
+/// other complete as not found without searching. Tiles in reach of towers can cost extra steps,
+/// so the paths found go around the defenses where a detour is cheap enough.
+class PathRequestService : public Object
+{
+	OBJECT(PathRequestService);
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	PathRequestService(Context* context);
+	~PathRequestService();
+
+	/// Take a copy of the walkable tiles and the tile layout for world positions. Drops all requests.
+	void SetGrid(const DenseGrid& grid, const TileMapInfo2D& info);
+	/// Make tile walkable or not. Searches still running restart on the new map.
+	void SetWalkable(const IntVector2& tile, bool walkable);
+	/// Set the search time per frame in microseconds.
+	void SetBudget(unsigned usec) { budget_ = usec; }
+	unsigned GetBudget() const { return budget_; }
+	/// Set the extra steps a tile costs per damage per second the towers deal on it. 0 ignores the towers.
+	void SetThreatCost(float cost);
+	float GetThreatCost() const { return threatCost_; }
+	/// Place, change or with a damage per second of 0 remove the threat of the tower on tile. Range is in tiles. Searches still running restart.
+	void SetThreat(const IntVector2& tile, float range, float damagePerSecond);
+	/// Set whether finished paths keep only their line-of-sight corners instead of every tile. Not done while the threat cost is on.
+	void SetAnyAngle(bool enable) { anyAngle_ = enable; }
+	bool GetAnyAngle() const { return anyAngle_; }
+
+	/// Queue a search from start to goal. Returns the handle sent with E_PATHCOMPLETED, or 0 without a grid.
+	unsigned RequestPath(const IntVector2& start, const IntVector2& goal);
+	/// Forget a request, finished or not. No event is sent for it.
+	void CancelPath(unsigned handle);
+	/// Return whether a request is queued or being searched.
+	bool IsPending(unsigned handle) const;
+	/// Return whether the straight line between the tiles crosses only walkable tiles.
+	bool HasLineOfSight(const IntVector2& from, const IntVector2& to) const;
+	/// Get a finished path from start to goal as tile positions, optionally with its tiles, and forget the request. Returns false when unfinished or no path exists.
+	bool TakePath(unsigned handle, Vector<Vector2>& path, PODVector<IntVector2>* tiles = 0);
+
+protected:
+	/// Handle the logic update event.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+	DenseGridWithInfluence* grid_;
+	PathRequestQueue<DenseGridWithInfluence, BucketQueue<int> >* requests_;
+	/// Connected parts of grid_, kept up to date by SetWalkable.
+	ComponentLabels<DenseGridWithInfluence>* components_;
+	/// Damage per second of the towers on every tile, in hundredths; the cost layer of grid_.
+	InfluenceMap* threat_;
+	TileMapInfo2D info_;
+	/// Search time per frame in microseconds.
+	unsigned budget_;
+	/// Whether paths are pulled straight between corners.
+	bool anyAngle_;
+	/// Extra steps per damage per second.
+	float threatCost_;
+};
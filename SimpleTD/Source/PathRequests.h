@@ -0,0 +1,189 @@
+#pragma once
+
+#include "Pathfinding.h"
+#include "ConnectedComponents.h"
+
+#include <deque>
+
+// Path requests answered a slice at a time. request() only queues a search
+// and returns a handle; update() then runs the A* searches, oldest request
+// first, until its expired() callback says the frame's budget is used up,
+// and resumes where it stopped on the next call. The caller picks the
+// clock, so a frame can give the searches a fixed number of microseconds
+// and the frame time stays flat however large the map is.
+//
+// The searches read the graph between calls, so it must stay valid and only
+// change between update() calls. A search restarts when the graph's revision
+// moves, see DenseGrid::revision, so a result always belongs to the map as it
+// was when the search finished.
+//
+// With components set, a request between cells of different components
+// finishes as not found when its turn comes, without a search. The labels
+// must follow the same walls as the graph.
+template<typename Graph, typename Frontier = BucketQueue<int> >
+struct PathRequestQueue {
+	typedef typename Graph::Location Location;
+	// 0 is never a valid handle
+	typedef unsigned Handle;
+
+	enum Status { UNKNOWN, QUEUED, RUNNING, FOUND, NOT_FOUND };
+	// expansions between two looks at the clock
+	enum { CHECK_INTERVAL = 64 };
+
+	const Graph& graph;
+	// requests finished by the last update(), in the order they finished
+	vector<Handle> completed;
+	// labels of the graph's components, or null to search every request
+	ComponentLabels<Graph>* components;
+
+	explicit PathRequestQueue(const Graph& graph_)
+		: graph(graph_), components(nullptr), next_handle(1), active(0), revision(0), goal_index(0), workspace(graph_) {}
+
+	Handle request(Location start, Location goal) {
+		Handle handle = next_handle++;
+		if (next_handle == 0) {
+			next_handle = 1;
+		}
+		Request& request = requests[handle];
+		request.start = start;
+		request.goal = goal;
+		request.status = QUEUED;
+		queue.push_back(handle);
+		return handle;
+	}
+
+	Status status(Handle handle) const {
+		auto found = requests.find(handle);
+		return found != requests.end() ? found->second.status : UNKNOWN;
+	}
+
+	inline bool pending() const {
+		return active != 0 || !queue.empty();
+	}
+
+	// Moves the path of a finished request, goal to start like
+	// reconstruct_path, into path and forgets the request. False while the
+	// request is still queued or running, and when no path was found.
+	bool take(Handle handle, vector<Location>& path) {
+		auto found = requests.find(handle);
+		if (found == requests.end() || found->second.status == QUEUED || found->second.status == RUNNING) {
+			return false;
+		}
+		bool success = found->second.status == FOUND;
+		path.swap(found->second.path);
+		requests.erase(found);
+		return success;
+	}
+
+	// Drops a request in any state. Queued handles are skipped lazily.
+	void cancel(Handle handle) {
+		if (handle == active) {
+			active = 0;
+		}
+		requests.erase(handle);
+	}
+
+	// Works on the queued searches until expired() returns true or nothing
+	// is left. Always does at least one slice, so every frame makes some
+	// progress even on a tiny budget.
+	template<typename Expired>
+	void update(Expired expired) {
+		completed.clear();
+		do {
+			if (active == 0 && !start_next()) {
+				return;
+			}
+			if (graph.revision != revision && !restart()) {
+				continue;
+			}
+			step(CHECK_INTERVAL);
+		} while (!expired());
+	}
+
+private:
+	struct Request {
+		Location start, goal;
+		Status status;
+		vector<Location> path;
+	};
+
+	unordered_map<Handle, Request> requests;
+	std::deque<Handle> queue;
+	Handle next_handle;
+	// request being searched, 0 when none
+	Handle active;
+	// graph revision the active search started on
+	unsigned revision;
+	int goal_index;
+	SearchWorkspace<Graph, Frontier> workspace;
+
+	bool start_next() {
+		while (!queue.empty()) {
+			Handle handle = queue.front();
+			queue.pop_front();
+			auto found = requests.find(handle);
+			if (found != requests.end()) {
+				active = handle;
+				found->second.status = RUNNING;
+				if (restart()) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// False when the request was turned down instead.
+	bool restart() {
+		const Request& request = requests[active];
+		revision = graph.revision;
+		if (components && !components->connected(request.start, request.goal)) {
+			finish(false);
+			return false;
+		}
+		goal_index = graph.index(request.goal);
+		workspace.begin();
+		int s = graph.index(request.start);
+		workspace.frontier.put(s, 0);
+		workspace.visit(s, s, 0);
+		return true;
+	}
+
+	void finish(bool success) {
+		Request& request = requests[active];
+		request.status = success ? FOUND : NOT_FOUND;
+		if (success) {
+			const vector<Location>& path = workspace.reconstruct_path(graph, request.start, request.goal);
+			request.path.assign(path.begin(), path.end());
+		}
+		completed.push_back(active);
+		active = 0;
+	}
+
+	// Same loop as the workspace a_star_search, stopped after expansions.
+	void step(int expansions) {
+		Location goal = graph.location(goal_index);
+		for (int i = 0; i < expansions; ++i) {
+			if (workspace.frontier.empty()) {
+				finish(false);
+				return;
+			}
+			int current = workspace.frontier.get();
+
+			if (current == goal_index) {
+				finish(true);
+				return;
+			}
+
+			Location id = graph.location(current);
+			for_each_edge(graph, id, [&](Location next, int cost) {
+				int n = graph.index(next);
+				int new_cost = workspace.cost_so_far[current] + cost;
+				if (!workspace.reached(n) || new_cost < workspace.cost_so_far[n]) {
+					workspace.visit(n, current, new_cost);
+					workspace.frontier.put(n, new_cost + heuristic(graph, next, goal));
+				}
+			});
+		}
+	}
+};
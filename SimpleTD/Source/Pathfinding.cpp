@@ -0,0 +1,20 @@
+﻿
+/*
+Sample code from http://www.redblobgames.com/pathfinding/
+Copyright 2014 Red Blob Games <redblobgames@gmail.com>
+
+Feel free to use this code in your own projects, including commercial projects
+License: Apache v2.0 <http://www.apache.org/licenses/LICENSE-2.0.html>
+*/
+
+#include "Pathfinding.h"
+
+Graph<char> example_graph{ {
+	{ 'A', { 'B' } },
+	{ 'B', { 'A', 'C', 'D' } },
+	{ 'C', { 'A' } },
+	{ 'D', { 'E', 'A' } },
+	{ 'E', { 'B' } }
+} };
+
+array<SquareGrid::Location, 4> SquareGrid::DIRS{ Location{ 1, 0 }, Location{ 0, -1 }, Location{ -1, 0 }, Location{ 0, 1 } };
@@ -20,7 +20,17 @@ License: Apache v2.0 <http://www.apache.org/licenses/LICENSE-2.0.html>
 #include <queue>
 #include <tuple>
 #include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#ifdef _MSC_VER
 #include <xfunctional>
+#else
+#include <functional>
+#endif
 
 using std::unordered_map;
 using std::unordered_set;
@@ -39,18 +49,168 @@ struct Graph {
 	typedef typename vector<Location>::iterator iterator;
 	unordered_map<Location, vector<Location> > edges;
 
-	inline const vector<Location>  neighbors(Location id) {
-		return edges[id];
+	inline const vector<Location>& neighbors(Location id) const {
+		static const vector<Location> none;
+		auto found = edges.find(id);
+		return found != edges.end() ? found->second : none;
+	}
+
+	template<typename Visitor>
+	inline void for_each_neighbor(Location id, Visitor visit) const {
+		for (auto next : neighbors(id)) {
+			visit(next);
+		}
 	}
 };
 
-Graph<char> example_graph{ {
-	{ 'A', { 'B' } },
-	{ 'B', { 'A', 'C', 'D' } },
-	{ 'C', { 'A' } },
-	{ 'D', { 'E', 'A' } },
-	{ 'E', { 'B' } }
-} };
+extern Graph<char> example_graph;
+
+// Compressed sparse row graph for large waypoint networks. Locations are
+// remapped to dense ids 0..size()-1, and the searches run on those ids:
+// the edges out of id are targets[offsets[id]] up to targets[offsets[id + 1]],
+// with their costs at the same positions in weights, or 1 each when
+// weights is empty. node() and id() translate between ids and locations.
+template<typename L>
+struct CSRGraph {
+	typedef int Location;
+	typedef tuple<L, L, int> Edge;
+
+	struct NeighborList {
+		const int* first;
+		const int* last;
+		inline const int* begin() const { return first; }
+		inline const int* end() const { return last; }
+	};
+
+	vector<int> offsets;
+	vector<int> targets;
+	vector<int> weights;
+	vector<L> nodes;
+	unordered_map<L, int> ids;
+
+	CSRGraph() : offsets(1, 0) {}
+
+	// Unit costs, same edges as graph.
+	explicit CSRGraph(const Graph<L>& graph) {
+		vector<Edge> edges;
+		for (auto& node : graph.edges) {
+			add_node(node.first);
+			for (auto next : node.second) {
+				edges.emplace_back(node.first, next, 1);
+			}
+		}
+		build(edges, false);
+	}
+
+	// Directed, weighted edges.
+	explicit CSRGraph(const vector<Edge>& edges) {
+		build(edges, true);
+	}
+
+	// As above, with ids handed out in the order of nodes first, so they
+	// do not depend on the edge order.
+	CSRGraph(const vector<L>& nodes_, const vector<Edge>& edges) {
+		for (auto& node : nodes_) {
+			add_node(node);
+		}
+		build(edges, true);
+	}
+
+	inline int size() const {
+		return int(nodes.size());
+	}
+
+	inline int index(Location id) const {
+		return id;
+	}
+
+	inline Location location(int index) const {
+		return index;
+	}
+
+	inline const L& node(Location id) const {
+		return nodes[id];
+	}
+
+	// -1 for locations that are not in the graph.
+	inline Location id(const L& node) const {
+		auto found = ids.find(node);
+		return found != ids.end() ? found->second : -1;
+	}
+
+	inline NeighborList neighbors(Location id) const {
+		NeighborList list = { targets.data() + offsets[id], targets.data() + offsets[id + 1] };
+		return list;
+	}
+
+	template<typename Visitor>
+	inline void for_each_neighbor(Location id, Visitor visit) const {
+		for (int e = offsets[id]; e < offsets[id + 1]; ++e) {
+			visit(targets[e]);
+		}
+	}
+
+	template<typename Visitor>
+	inline void for_each_edge(Location id, Visitor visit) const {
+		if (weights.empty()) {
+			for_each_neighbor(id, [&](Location next) { visit(next, 1); });
+			return;
+		}
+		for (int e = offsets[id]; e < offsets[id + 1]; ++e) {
+			visit(targets[e], weights[e]);
+		}
+	}
+
+	// Scans the edges of a; searches get the cost from for_each_edge instead.
+	int cost(Location a, Location b) const {
+		if (weights.empty()) {
+			return 1;
+		}
+		for (int e = offsets[a]; e < offsets[a + 1]; ++e) {
+			if (targets[e] == b) {
+				return weights[e];
+			}
+		}
+		return std::numeric_limits<int>::max();
+	}
+
+private:
+	int add_node(const L& node) {
+		auto inserted = ids.emplace(node, int(nodes.size()));
+		if (inserted.second) {
+			nodes.push_back(node);
+		}
+		return inserted.first->second;
+	}
+
+	// Counting sort of the edges by source id.
+	void build(const vector<Edge>& edges, bool weighted) {
+		vector<int> sources(edges.size());
+		for (size_t i = 0; i < edges.size(); ++i) {
+			sources[i] = add_node(std::get<0>(edges[i]));
+			add_node(std::get<1>(edges[i]));
+		}
+		offsets.assign(nodes.size() + 1, 0);
+		for (int source : sources) {
+			++offsets[source + 1];
+		}
+		for (size_t i = 1; i < offsets.size(); ++i) {
+			offsets[i] += offsets[i - 1];
+		}
+		vector<int> fill(offsets.begin(), offsets.end() - 1);
+		targets.resize(edges.size());
+		if (weighted) {
+			weights.resize(edges.size());
+		}
+		for (size_t i = 0; i < edges.size(); ++i) {
+			int e = fill[sources[i]]++;
+			targets[e] = ids[std::get<1>(edges[i])];
+			if (weighted) {
+				weights[e] = std::get<2>(edges[i]);
+			}
+		}
+	}
+};
 
 // Helpers for SquareGrid::Location
 
@@ -66,7 +226,7 @@ namespace std {
 	};
 }
 
-std::basic_iostream<char>::basic_ostream& operator<<(std::basic_iostream<char>::basic_ostream& out, tuple<int, int> loc) {
+inline std::basic_iostream<char>::basic_ostream& operator<<(std::basic_iostream<char>::basic_ostream& out, tuple<int, int> loc) {
 	int x, y;
 	tie(x, y) = loc;
 	out << '(' << x << ',' << y << ')';
@@ -161,17 +321,17 @@ struct SquareGrid {
 	SquareGrid(int width_, int height_)
 		: width(width_), height(height_) {}
 
-	inline bool in_bounds(Location id) {
+	inline bool in_bounds(Location id) const {
 		int x, y;
 		tie(x, y) = id;
 		return 0 <= x && x < width && 0 <= y && y < height;
 	}
 
-	inline bool passable(Location id) {
+	inline bool passable(Location id) const {
 		return !walls.count(id);
 	}
 
-	vector<Location> neighbors(Location id) {
+	vector<Location> neighbors(Location id) const {
 		int x, y, dx, dy;
 		tie(x, y) = id;
 		vector<Location> results;
@@ -191,11 +351,25 @@ struct SquareGrid {
 
 		return results;
 	}
-};
 
-array<SquareGrid::Location, 4> SquareGrid::DIRS{ Location{ 1, 0 }, Location{ 0, -1 }, Location{ -1, 0 }, Location{ 0, 1 } };
+	// Same order as neighbors(), without building the vector.
+	template<typename Visitor>
+	void for_each_neighbor(Location id, Visitor visit) const {
+		int x, y, dx, dy;
+		tie(x, y) = id;
+		bool reversed = (x + y) % 2 == 0;
+
+		for (int i = 0; i < 4; ++i) {
+			tie(dx, dy) = DIRS[reversed ? 3 - i : i];
+			Location next(x + dx, y + dy);
+			if (in_bounds(next) && passable(next)) {
+				visit(next);
+			}
+		}
+	}
+};
 
-void add_rect(SquareGrid& grid, int x1, int y1, int x2, int y2) {
+inline void add_rect(SquareGrid& grid, int x1, int y1, int x2, int y2) {
 	for (int x = x1; x < x2; ++x) {
 		for (int y = y1; y < y2; ++y) {
 			grid.walls.insert(SquareGrid::Location{ x, y });
@@ -203,7 +377,7 @@ void add_rect(SquareGrid& grid, int x1, int y1, int x2, int y2) {
 	}
 }
 
-SquareGrid make_diagram1() {
+inline SquareGrid make_diagram1() {
 	SquareGrid grid(30, 15);
 	add_rect(grid, 3, 3, 5, 12);
 	add_rect(grid, 13, 4, 15, 15);
@@ -212,166 +386,1479 @@ SquareGrid make_diagram1() {
 	return grid;
 }
 
-template<typename Graph>
-unordered_map<typename Graph::Location, typename Graph::Location>
-breadth_first_search(Graph graph,
-typename Graph::Location start,
-typename Graph::Location goal) {
-	typedef typename Graph::Location Location;
-	queue<Location> frontier;
-	frontier.push(start);
+// Dense grid backend. Walkability is a bitset and search results live in
+// flat arrays indexed by y * width + x, so the searches never hash a
+// location or allocate a node per visited cell.
 
-	unordered_map<Location, Location> came_from;
-	came_from[start] = start;
+struct DenseBitset {
+	vector<uint64_t> words;
 
-	while (!frontier.empty()) {
-		auto current = frontier.front();
-		frontier.pop();
+	DenseBitset() {}
+	explicit DenseBitset(size_t size, bool value = false)
+		: words((size + 63) / 64, value ? ~uint64_t(0) : uint64_t(0)) {}
 
-		if (current == goal) {
-			break;
-		}
+	inline bool test(size_t i) const {
+		return ((words[i >> 6] >> (i & 63)) & 1) != 0;
+	}
 
-		for (auto next : graph.neighbors(current)) {
-			if (!came_from.count(next)) {
-				frontier.push(next);
-				came_from[next] = current;
-			}
-		}
+	inline void set(size_t i) {
+		words[i >> 6] |= uint64_t(1) << (i & 63);
 	}
-	return came_from;
-}
 
-struct GridWithWeights : SquareGrid {
-	unordered_set<Location> forests;
-	GridWithWeights(int w, int h) : SquareGrid(w, h) {}
-	int cost(Location a, Location b) {
-		return forests.count(b) ? 5 : 1;
+	inline void reset(size_t i) {
+		words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+	}
+
+	inline void clear() {
+		std::fill(words.begin(), words.end(), uint64_t(0));
 	}
 };
 
-GridWithWeights make_diagram4() {
-	GridWithWeights grid(10, 10);
-	add_rect(grid, 1, 7, 4, 9);
-	typedef SquareGrid::Location L;
-	grid.forests = unordered_set<SquareGrid::Location> {
-		L{ 3, 4 }, L{ 3, 5 }, L{ 4, 1 }, L{ 4, 2 },
-			L{ 4, 3 }, L{ 4, 4 }, L{ 4, 5 }, L{ 4, 6 },
-			L{ 4, 7 }, L{ 4, 8 }, L{ 5, 1 }, L{ 5, 2 },
-			L{ 5, 3 }, L{ 5, 4 }, L{ 5, 5 }, L{ 5, 6 },
-			L{ 5, 7 }, L{ 5, 8 }, L{ 6, 2 }, L{ 6, 3 },
-			L{ 6, 4 }, L{ 6, 5 }, L{ 6, 6 }, L{ 6, 7 },
-			L{ 7, 3 }, L{ 7, 4 }, L{ 7, 5 }
-	};
-	return grid;
+// Index into SquareGrid::DIRS of the step (dx, dy).
+inline int direction_code(int dx, int dy) {
+	return dx != 0 ? 1 - dx : 2 + dy;
 }
 
-template<typename T, typename Number = int>
-struct PriorityQueue {
-	typedef pair<Number, T> PQElement;
-	priority_queue<PQElement, vector<PQElement>,
-		std::greater<PQElement >> elements;
+struct DenseGrid {
+	typedef tuple<int, int> Location;
+	enum { MAX_NEIGHBORS = 4 };
 
-	inline bool empty() { return elements.empty(); }
+	// Fixed capacity neighbor list, so neighbors() never touches the heap.
+	struct NeighborList {
+		array<Location, 4> items;
+		int count;
 
-	inline void put(T item, Number priority) {
-		elements.emplace(priority, item);
+		NeighborList() : count(0) {}
+		inline void push_back(Location id) { items[count++] = id; }
+		inline const Location* begin() const { return items.data(); }
+		inline const Location* end() const { return items.data() + count; }
+	};
+
+	int width, height;
+	DenseBitset walkable;
+	// Bumped by every wall edit that changes the map, so anything derived
+	// from it, like a cached path, can tell it went stale.
+	unsigned revision;
+
+	DenseGrid(int width_, int height_)
+		: width(width_), height(height_), walkable(size_t(width_) * height_, true), revision(0) {}
+
+	explicit DenseGrid(const SquareGrid& grid)
+		: width(grid.width), height(grid.height), walkable(size_t(grid.width) * grid.height, true), revision(0) {
+		for (auto wall : grid.walls) {
+			add_wall(wall);
+		}
 	}
 
-	inline T get() {
-		T best_item = elements.top().second;
-		elements.pop();
-		return best_item;
+	inline int size() const {
+		return width * height;
 	}
-};
 
-template<typename Graph>
-void dijkstra_search
-(Graph graph,
-typename Graph::Location start,
-typename Graph::Location goal,
-unordered_map<typename Graph::Location, typename Graph::Location>& came_from,
-unordered_map<typename Graph::Location, int>& cost_so_far)
-{
-	typedef typename Graph::Location Location;
-	PriorityQueue<Location> frontier;
-	frontier.put(start, 0);
+	inline int index(Location id) const {
+		return std::get<1>(id) * width + std::get<0>(id);
+	}
 
-	came_from[start] = start;
-	cost_so_far[start] = 0;
+	inline Location location(int index) const {
+		return Location(index % width, index / width);
+	}
 
-	while (!frontier.empty()) {
-		auto current = frontier.get();
+	inline bool in_bounds(Location id) const {
+		int x, y;
+		tie(x, y) = id;
+		return 0 <= x && x < width && 0 <= y && y < height;
+	}
 
-		if (current == goal) {
-			break;
+	inline bool passable(Location id) const {
+		return walkable.test(index(id));
+	}
+
+	inline void add_wall(Location id) {
+		if (walkable.test(index(id))) {
+			walkable.reset(index(id));
+			++revision;
 		}
+	}
 
-		for (auto next : graph.neighbors(current)) {
-			int new_cost = cost_so_far[current] + graph.cost(current, next);
-			if (!cost_so_far.count(next) || new_cost < cost_so_far[next]) {
-				cost_so_far[next] = new_cost;
-				came_from[next] = current;
-				frontier.put(next, new_cost);
+	inline void remove_wall(Location id) {
+		if (!walkable.test(index(id))) {
+			walkable.set(index(id));
+			++revision;
+		}
+	}
+
+	inline int cost(Location, Location) const {
+		return 1;
+	}
+
+	// Same order as SquareGrid::neighbors, including the reversal on even cells.
+	NeighborList neighbors(Location id) const {
+		int x, y, dx, dy;
+		tie(x, y) = id;
+		NeighborList results;
+		bool reversed = (x + y) % 2 == 0;
+
+		for (int i = 0; i < 4; ++i) {
+			tie(dx, dy) = SquareGrid::DIRS[reversed ? 3 - i : i];
+			Location next(x + dx, y + dy);
+			if (in_bounds(next) && passable(next)) {
+				results.push_back(next);
 			}
 		}
+		return results;
 	}
-}
 
+	template<typename Visitor>
+	void for_each_neighbor(Location id, Visitor visit) const {
+		int x, y, dx, dy;
+		tie(x, y) = id;
+		bool reversed = (x + y) % 2 == 0;
 
-template<typename Location>
-vector<Location> reconstruct_path(
-	Location start,
-	Location goal,
-	unordered_map<Location, Location>& came_from
-	) {
-	vector<Location> path;
-	Location current = goal;
-	path.push_back(current);
-	while (current != start) {
-		current = came_from[current];
-		path.push_back(current);
+		for (int i = 0; i < 4; ++i) {
+			tie(dx, dy) = SquareGrid::DIRS[reversed ? 3 - i : i];
+			Location next(x + dx, y + dy);
+			if (in_bounds(next) && passable(next)) {
+				visit(next);
+			}
+		}
 	}
-	return path;
-}
+};
 
-inline int heuristic(SquareGrid::Location a, SquareGrid::Location b) {
-	int x1, y1, x2, y2;
-	tie(x1, y1) = a;
-	tie(x2, y2) = b;
-	return abs(x1 - x2) + abs(y1 - y2);
+inline void add_rect(DenseGrid& grid, int x1, int y1, int x2, int y2) {
+	for (int x = x1; x < x2; ++x) {
+		for (int y = y1; y < y2; ++y) {
+			grid.add_wall(DenseGrid::Location{ x, y });
+		}
+	}
 }
 
-template<typename Graph>
-void a_star_search
-(Graph graph,
-typename Graph::Location start,
-typename Graph::Location goal,
-unordered_map<typename Graph::Location, typename Graph::Location>& came_from,
-unordered_map<typename Graph::Location, int>& cost_so_far)
-{
-	typedef typename Graph::Location Location;
-	PriorityQueue<Location> frontier;
-	frontier.put(start, 0);
+// Compile time policies for PolicyGrid. A connectivity policy enumerates
+// the open neighbors of a cell and sets the step costs; a heuristic policy
+// estimates the cost between two cells in those units.
 
-	came_from[start] = start;
-	cost_so_far[start] = 0;
+struct FourWay {
+	enum { MAX_NEIGHBORS = 4, STRAIGHT = 1, DIAGONAL = 2 };
 
-	while (!frontier.empty()) {
-		auto current = frontier.get();
+	template<typename Grid, typename Visitor>
+	static inline void for_each_neighbor(const Grid& grid, int x, int y, Visitor& visit) {
+		typedef typename Grid::Location Location;
+		if (grid.open(x + 1, y)) { visit(Location(x + 1, y)); }
+		if (grid.open(x, y - 1)) { visit(Location(x, y - 1)); }
+		if (grid.open(x - 1, y)) { visit(Location(x - 1, y)); }
+		if (grid.open(x, y + 1)) { visit(Location(x, y + 1)); }
+	}
+};
 
-		if (current == goal) {
-			break;
+// Diagonal steps cost 14 against 10 for straight ones.
+struct EightWay {
+	enum { MAX_NEIGHBORS = 8, STRAIGHT = 10, DIAGONAL = 14 };
+
+	template<typename Grid, typename Visitor>
+	static inline void for_each_neighbor(const Grid& grid, int x, int y, Visitor& visit) {
+		typedef typename Grid::Location Location;
+		FourWay::for_each_neighbor(grid, x, y, visit);
+		if (grid.open(x + 1, y - 1)) { visit(Location(x + 1, y - 1)); }
+		if (grid.open(x - 1, y - 1)) { visit(Location(x - 1, y - 1)); }
+		if (grid.open(x - 1, y + 1)) { visit(Location(x - 1, y + 1)); }
+		if (grid.open(x + 1, y + 1)) { visit(Location(x + 1, y + 1)); }
+	}
+};
+
+// Like EightWay, but a diagonal step needs both cells it passes between
+// to be open, so units never clip the corner of a wall.
+struct EightWayNoCornerCutting {
+	enum { MAX_NEIGHBORS = 8, STRAIGHT = 10, DIAGONAL = 14 };
+
+	template<typename Grid, typename Visitor>
+	static inline void for_each_neighbor(const Grid& grid, int x, int y, Visitor& visit) {
+		typedef typename Grid::Location Location;
+		bool east = grid.open(x + 1, y), north = grid.open(x, y - 1);
+		bool west = grid.open(x - 1, y), south = grid.open(x, y + 1);
+		if (east) { visit(Location(x + 1, y)); }
+		if (north) { visit(Location(x, y - 1)); }
+		if (west) { visit(Location(x - 1, y)); }
+		if (south) { visit(Location(x, y + 1)); }
+		if (east && north && grid.open(x + 1, y - 1)) { visit(Location(x + 1, y - 1)); }
+		if (west && north && grid.open(x - 1, y - 1)) { visit(Location(x - 1, y - 1)); }
+		if (west && south && grid.open(x - 1, y + 1)) { visit(Location(x - 1, y + 1)); }
+		if (east && south && grid.open(x + 1, y + 1)) { visit(Location(x + 1, y + 1)); }
+	}
+};
+
+// Exact for FourWay. With diagonal moves it overestimates, so PolicyGrid
+// does not accept it there.
+struct Manhattan {
+	template<typename Connectivity>
+	static inline int distance(int dx, int dy) {
+		return Connectivity::STRAIGHT * (dx + dy);
+	}
+};
+
+// Exact on an open grid for every connectivity; equals Manhattan for FourWay.
+struct Octile {
+	template<typename Connectivity>
+	static inline int distance(int dx, int dy) {
+		return Connectivity::STRAIGHT * std::max(dx, dy) + (Connectivity::DIAGONAL - Connectivity::STRAIGHT) * std::min(dx, dy);
+	}
+};
+
+// Straight line distance, scaled down so it never exceeds the cost of a
+// straight or a diagonal step.
+struct Euclidean {
+	template<typename Connectivity>
+	static inline int distance(int dx, int dy) {
+		double scale = std::min(double(Connectivity::STRAIGHT), Connectivity::DIAGONAL / std::sqrt(2.0));
+		return int(std::sqrt(double(dx * dx + dy * dy)) * scale);
+	}
+};
+
+// Dense grid with connectivity and heuristic fixed at compile time. The
+// searches enumerate neighbors through for_each_neighbor, which the policy
+// unrolls into a handful of bit tests.
+template<typename Connectivity = FourWay, typename Heuristic = Manhattan>
+struct PolicyGrid : DenseGrid {
+	enum { MAX_NEIGHBORS = Connectivity::MAX_NEIGHBORS };
+	static_assert(!std::is_same<Heuristic, Manhattan>::value || MAX_NEIGHBORS == 4,
+		"Manhattan overestimates with diagonal moves; use Octile or Euclidean");
+
+	struct NeighborList {
+		array<Location, MAX_NEIGHBORS> items;
+		int count;
+
+		NeighborList() : count(0) {}
+		inline void operator()(Location id) { items[count++] = id; }
+		inline const Location* begin() const { return items.data(); }
+		inline const Location* end() const { return items.data() + count; }
+	};
+
+	PolicyGrid(int width_, int height_) : DenseGrid(width_, height_) {}
+	explicit PolicyGrid(const DenseGrid& grid) : DenseGrid(grid) {}
+
+	// The unsigned compares also reject negative coordinates.
+	inline bool open(int x, int y) const {
+		return unsigned(x) < unsigned(width) && unsigned(y) < unsigned(height) && walkable.test(y * width + x);
+	}
+
+	template<typename Visitor>
+	inline void for_each_neighbor(Location id, Visitor visit) const {
+		Connectivity::for_each_neighbor(*this, std::get<0>(id), std::get<1>(id), visit);
+	}
+
+	NeighborList neighbors(Location id) const {
+		NeighborList results;
+		Connectivity::for_each_neighbor(*this, std::get<0>(id), std::get<1>(id), results);
+		return results;
+	}
+
+	inline int cost(Location a, Location b) const {
+		bool diagonal = std::get<0>(a) != std::get<0>(b) && std::get<1>(a) != std::get<1>(b);
+		return diagonal ? int(Connectivity::DIAGONAL) : int(Connectivity::STRAIGHT);
+	}
+
+	inline int heuristic(Location a, Location b) const {
+		return Heuristic::template distance<Connectivity>(abs(std::get<0>(a) - std::get<0>(b)), abs(std::get<1>(a) - std::get<1>(b)));
+	}
+};
+
+// came_from for a DenseGrid. Every parent is a grid neighbor, so it is
+// stored as a 2-bit index into SquareGrid::DIRS next to a visited bit;
+// only the search root points at itself.
+struct DenseCameFrom {
+	typedef DenseGrid::Location Location;
+
+	class reference {
+	public:
+		reference(DenseCameFrom& map_, Location id_) : map(map_), id(id_) {}
+		inline operator Location() const { return map.at(id); }
+		inline reference& operator=(Location parent) {
+			map.assign(id, parent);
+			return *this;
 		}
+	private:
+		DenseCameFrom& map;
+		Location id;
+	};
 
-		for (auto next : graph.neighbors(current)) {
-			int new_cost = cost_so_far[current] + graph.cost(current, next);
-			if (!cost_so_far.count(next) || new_cost < cost_so_far[next]) {
-				cost_so_far[next] = new_cost;
-				int priority = new_cost + heuristic(next, goal);
-				frontier.put(next, priority);
-				came_from[next] = current;
-			}
+	int width;
+	int root;
+	DenseBitset visited;
+	vector<uint8_t> codes;
+
+	explicit DenseCameFrom(const DenseGrid& grid)
+		: width(grid.width), root(-1), visited(grid.size()), codes((grid.size() + 3) / 4, 0) {}
+
+	inline int index(Location id) const {
+		return std::get<1>(id) * width + std::get<0>(id);
+	}
+
+	inline size_t count(Location id) const {
+		return visited.test(index(id)) ? 1 : 0;
+	}
+
+	Location at(Location id) const {
+		int i = index(id);
+		if (i == root) {
+			return id;
 		}
+		int x, y, dx, dy;
+		tie(x, y) = id;
+		tie(dx, dy) = SquareGrid::DIRS[(codes[i >> 2] >> ((i & 3) * 2)) & 3];
+		return Location(x + dx, y + dy);
 	}
-}
+
+	void assign(Location id, Location parent) {
+		int i = index(id);
+		visited.set(i);
+		if (id == parent) {
+			root = i;
+			return;
+		}
+		int shift = (i & 3) * 2;
+		int code = direction_code(std::get<0>(parent) - std::get<0>(id), std::get<1>(parent) - std::get<1>(id));
+		codes[i >> 2] = uint8_t((codes[i >> 2] & ~(3 << shift)) | (code << shift));
+	}
+
+	inline reference operator[](Location id) {
+		return reference(*this, id);
+	}
+};
+
+// cost_so_far for a DenseGrid; unvisited cells hold INT_MAX.
+struct DenseCostSoFar {
+	typedef DenseGrid::Location Location;
+
+	int width;
+	vector<int> costs;
+
+	explicit DenseCostSoFar(const DenseGrid& grid)
+		: width(grid.width), costs(grid.size(), std::numeric_limits<int>::max()) {}
+
+	inline int index(Location id) const {
+		return std::get<1>(id) * width + std::get<0>(id);
+	}
+
+	inline size_t count(Location id) const {
+		return costs[index(id)] != std::numeric_limits<int>::max() ? 1 : 0;
+	}
+
+	inline int& operator[](Location id) {
+		return costs[index(id)];
+	}
+};
+
+// DenseCameFrom only has room for the four straight directions.
+template<typename Graph, bool Dense = std::is_base_of<DenseGrid, Graph>::value>
+struct HasDenseStorage : std::false_type {};
+
+template<typename Graph>
+struct HasDenseStorage<Graph, true> : std::integral_constant<bool, Graph::MAX_NEIGHBORS == 4> {};
+
+// Result containers used by the search templates for a given graph type.
+// Hash maps work for any graph; dense grids get the flat arrays above.
+template<typename Graph, bool Dense = HasDenseStorage<Graph>::value>
+struct SearchStorage {
+	typedef typename Graph::Location Location;
+	typedef unordered_map<Location, Location> CameFrom;
+	typedef unordered_map<Location, int> CostSoFar;
+
+	static CameFrom make_came_from(const Graph&) { return CameFrom(); }
+	static CostSoFar make_cost_so_far(const Graph&) { return CostSoFar(); }
+};
+
+template<typename Graph>
+struct SearchStorage<Graph, true> {
+	typedef DenseCameFrom CameFrom;
+	typedef DenseCostSoFar CostSoFar;
+
+	static CameFrom make_came_from(const Graph& graph) { return CameFrom(graph); }
+	static CostSoFar make_cost_so_far(const Graph& graph) { return CostSoFar(graph); }
+};
+
+// came_from and cost_so_far over dense ids; missing marks unset entries.
+template<typename T>
+struct DenseIdMap {
+	vector<T> values;
+	T missing;
+
+	DenseIdMap(int size, T missing_) : values(size, missing_), missing(missing_) {}
+
+	inline size_t count(int id) const {
+		return values[id] != missing ? 1 : 0;
+	}
+
+	inline T& operator[](int id) {
+		return values[id];
+	}
+};
+
+template<typename L>
+struct SearchStorage<CSRGraph<L>, false> {
+	typedef DenseIdMap<int> CameFrom;
+	typedef DenseIdMap<int> CostSoFar;
+
+	static CameFrom make_came_from(const CSRGraph<L>& graph) { return CameFrom(graph.size(), -1); }
+	static CostSoFar make_cost_so_far(const CSRGraph<L>& graph) { return CostSoFar(graph.size(), std::numeric_limits<int>::max()); }
+};
+
+// Calls visit(next, cost) for every edge out of id. Graphs that store
+// costs next to their edges provide a for_each_edge of their own; the rest
+// go through for_each_neighbor and cost().
+template<typename Graph, typename Visitor>
+inline void for_each_edge(const Graph& graph, typename Graph::Location id, Visitor visit) {
+	graph.for_each_neighbor(id, [&](typename Graph::Location next) {
+		visit(next, graph.cost(id, next));
+	});
+}
+
+template<typename L, typename Visitor>
+inline void for_each_edge(const CSRGraph<L>& graph, int id, Visitor visit) {
+	graph.for_each_edge(id, visit);
+}
+
+template<typename Graph>
+typename SearchStorage<Graph>::CameFrom
+breadth_first_search(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal) {
+	typedef typename Graph::Location Location;
+	queue<Location> frontier;
+	frontier.push(start);
+
+	typename SearchStorage<Graph>::CameFrom came_from = SearchStorage<Graph>::make_came_from(graph);
+	came_from[start] = start;
+
+	while (!frontier.empty()) {
+		auto current = frontier.front();
+		frontier.pop();
+
+		if (current == goal) {
+			break;
+		}
+
+		graph.for_each_neighbor(current, [&](Location next) {
+			if (!came_from.count(next)) {
+				frontier.push(next);
+				came_from[next] = current;
+			}
+		});
+	}
+	return came_from;
+}
+
+// Breadth first search outward from goal over the whole graph. came_from
+// then points every reached location one step closer to goal and
+// cost_so_far holds its step count, which together form a flow field.
+// Assumes symmetric edges, as on SquareGrid and DenseGrid.
+template<typename Graph>
+void reverse_breadth_first_search
+(const Graph& graph,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	typedef typename Graph::Location Location;
+	queue<Location> frontier;
+	frontier.push(goal);
+
+	came_from[goal] = goal;
+	cost_so_far[goal] = 0;
+
+	while (!frontier.empty()) {
+		auto current = frontier.front();
+		frontier.pop();
+
+		graph.for_each_neighbor(current, [&](Location next) {
+			if (!came_from.count(next)) {
+				frontier.push(next);
+				came_from[next] = current;
+				cost_so_far[next] = cost_so_far[current] + 1;
+			}
+		});
+	}
+}
+
+struct GridWithWeights : SquareGrid {
+	unordered_set<Location> forests;
+	GridWithWeights(int w, int h) : SquareGrid(w, h) {}
+	int cost(Location, Location b) const {
+		return forests.count(b) ? 5 : 1;
+	}
+};
+
+struct DenseGridWithWeights : DenseGrid {
+	DenseBitset forests;
+	DenseGridWithWeights(int w, int h) : DenseGrid(w, h), forests(size_t(w) * h) {}
+
+	explicit DenseGridWithWeights(const GridWithWeights& grid)
+		: DenseGrid(grid), forests(size_t(grid.width) * grid.height) {
+		for (auto forest : grid.forests) {
+			forests.set(index(forest));
+		}
+	}
+
+	inline int cost(Location, Location b) const {
+		return forests.test(index(b)) ? 5 : 1;
+	}
+};
+
+// Weighted CSRGraph of the open cells of a grid, with ids in row major
+// order, so the same map always gets the same ids.
+template<typename Grid>
+CSRGraph<typename Grid::Location> make_csr_graph(const Grid& grid) {
+	typedef typename Grid::Location Location;
+	vector<Location> nodes;
+	vector<typename CSRGraph<Location>::Edge> edges;
+	for (int y = 0; y < grid.height; ++y) {
+		for (int x = 0; x < grid.width; ++x) {
+			Location id(x, y);
+			if (grid.passable(id)) {
+				nodes.push_back(id);
+				for_each_edge(grid, id, [&](Location next, int cost) {
+					edges.emplace_back(id, next, cost);
+				});
+			}
+		}
+	}
+	return CSRGraph<Location>(nodes, edges);
+}
+
+inline GridWithWeights make_diagram4() {
+	GridWithWeights grid(10, 10);
+	add_rect(grid, 1, 7, 4, 9);
+	typedef SquareGrid::Location L;
+	grid.forests = unordered_set<SquareGrid::Location> {
+		L{ 3, 4 }, L{ 3, 5 }, L{ 4, 1 }, L{ 4, 2 },
+			L{ 4, 3 }, L{ 4, 4 }, L{ 4, 5 }, L{ 4, 6 },
+			L{ 4, 7 }, L{ 4, 8 }, L{ 5, 1 }, L{ 5, 2 },
+			L{ 5, 3 }, L{ 5, 4 }, L{ 5, 5 }, L{ 5, 6 },
+			L{ 5, 7 }, L{ 5, 8 }, L{ 6, 2 }, L{ 6, 3 },
+			L{ 6, 4 }, L{ 6, 5 }, L{ 6, 6 }, L{ 6, 7 },
+			L{ 7, 3 }, L{ 7, 4 }, L{ 7, 5 }
+	};
+	return grid;
+}
+
+template<typename T, typename Number = int>
+struct PriorityQueue {
+	typedef pair<Number, T> PQElement;
+	// exposes the underlying container so clear() keeps its storage
+	struct Heap : priority_queue<PQElement, vector<PQElement>,
+		std::greater<PQElement >> {
+		inline void clear() { this->c.clear(); }
+	};
+	Heap elements;
+
+	inline bool empty() { return elements.empty(); }
+
+	inline void put(T item, Number priority) {
+		elements.emplace(priority, item);
+	}
+
+	inline T get() {
+		T best_item = elements.top().second;
+		elements.pop();
+		return best_item;
+	}
+
+	inline void clear() {
+		elements.clear();
+	}
+};
+
+// Dial's bucket queue for small non-negative integer priorities. The
+// search must be monotone (never put a priority below the last one taken),
+// which holds for dijkstra_search and for a_star_search with a consistent
+// heuristic. put() and get() are O(1) amortized; equal priorities come out
+// last in, first out, so A* follows the deepest of several equal routes.
+template<typename T>
+struct BucketQueue {
+	vector<vector<T> > buckets;
+	size_t current;
+	size_t count;
+
+	BucketQueue() : current(0), count(0) {}
+
+	inline bool empty() { return count == 0; }
+
+	inline void put(T item, int priority) {
+		size_t bucket = std::max(size_t(priority), current);
+		if (bucket >= buckets.size()) {
+			buckets.resize(bucket * 2 + 1);
+		}
+		buckets[bucket].push_back(item);
+		++count;
+	}
+
+	inline T get() {
+		while (buckets[current].empty()) {
+			++current;
+		}
+		T best_item = buckets[current].back();
+		buckets[current].pop_back();
+		--count;
+		return best_item;
+	}
+
+	// Keeps the bucket storage for the next search.
+	inline void clear() {
+		for (size_t i = current; count > 0 && i < buckets.size(); ++i) {
+			count -= buckets[i].size();
+			buckets[i].clear();
+		}
+		current = 0;
+		count = 0;
+	}
+};
+
+// Radix heap for monotone non-negative integer priorities. Items are kept
+// in buckets by the highest bit in which their priority differs from the
+// last one taken, so each item moves down at most 32 times and no
+// comparisons between items are needed. Unlike BucketQueue the memory does
+// not grow with the largest priority.
+template<typename T>
+struct RadixHeap {
+	typedef pair<unsigned, T> Element;
+	array<vector<Element>, 33> buckets;
+	unsigned last;
+	size_t count;
+
+	RadixHeap() : last(0), count(0) {}
+
+	inline bool empty() { return count == 0; }
+
+	inline void put(T item, int priority) {
+		unsigned key = std::max(unsigned(priority), last);
+		buckets[bucket_of(key)].emplace_back(key, item);
+		++count;
+	}
+
+	inline T get() {
+		if (buckets[0].empty()) {
+			size_t i = 1;
+			while (buckets[i].empty()) {
+				++i;
+			}
+			vector<Element>& from = buckets[i];
+			last = from[0].first;
+			for (size_t j = 1; j < from.size(); ++j) {
+				last = std::min(last, from[j].first);
+			}
+			for (auto& element : from) {
+				buckets[bucket_of(element.first)].push_back(element);
+			}
+			from.clear();
+		}
+		T best_item = buckets[0].back().second;
+		buckets[0].pop_back();
+		--count;
+		return best_item;
+	}
+
+	inline void clear() {
+		for (auto& bucket : buckets) {
+			bucket.clear();
+		}
+		last = 0;
+		count = 0;
+	}
+
+private:
+	inline size_t bucket_of(unsigned key) const {
+		size_t bits = 0;
+		for (unsigned diff = key ^ last; diff != 0; diff >>= 1) {
+			++bits;
+		}
+		return bits;
+	}
+};
+
+// The frontier can be any queue with empty/put/get/clear, e.g.
+// PriorityQueue, BucketQueue or RadixHeap. Passing one in also keeps its
+// storage alive between searches.
+template<typename Graph, typename Frontier>
+void dijkstra_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far,
+Frontier& frontier)
+{
+	typedef typename Graph::Location Location;
+	frontier.clear();
+	frontier.put(start, 0);
+
+	came_from[start] = start;
+	cost_so_far[start] = 0;
+
+	while (!frontier.empty()) {
+		auto current = frontier.get();
+
+		if (current == goal) {
+			break;
+		}
+
+		for_each_edge(graph, current, [&](Location next, int step) {
+			int new_cost = cost_so_far[current] + step;
+			if (!cost_so_far.count(next) || new_cost < cost_so_far[next]) {
+				cost_so_far[next] = new_cost;
+				came_from[next] = current;
+				frontier.put(next, new_cost);
+			}
+		});
+	}
+}
+
+template<typename Graph>
+void dijkstra_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	PriorityQueue<typename Graph::Location> frontier;
+	dijkstra_search(graph, start, goal, came_from, cost_so_far, frontier);
+}
+
+
+// Weighted flow field: like reverse_breadth_first_search, but stepping
+// from next to current costs graph.cost(next, current).
+template<typename Graph>
+void reverse_dijkstra_search
+(const Graph& graph,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	typedef typename Graph::Location Location;
+	PriorityQueue<Location> frontier;
+	frontier.put(goal, 0);
+
+	came_from[goal] = goal;
+	cost_so_far[goal] = 0;
+
+	while (!frontier.empty()) {
+		auto current = frontier.get();
+
+		graph.for_each_neighbor(current, [&](Location next) {
+			int new_cost = cost_so_far[current] + graph.cost(next, current);
+			if (!cost_so_far.count(next) || new_cost < cost_so_far[next]) {
+				cost_so_far[next] = new_cost;
+				came_from[next] = current;
+				frontier.put(next, new_cost);
+			}
+		});
+	}
+}
+
+template<typename Location, typename CameFrom>
+vector<Location> reconstruct_path(
+	Location start,
+	Location goal,
+	CameFrom& came_from
+	) {
+	vector<Location> path;
+	Location current = goal;
+	path.push_back(current);
+	while (current != start) {
+		current = came_from[current];
+		path.push_back(current);
+	}
+	return path;
+}
+
+inline int heuristic(SquareGrid::Location a, SquareGrid::Location b) {
+	int x1, y1, x2, y2;
+	tie(x1, y1) = a;
+	tie(x2, y2) = b;
+	return abs(x1 - x2) + abs(y1 - y2);
+}
+
+// Heuristic used by a_star_search: grids with a heuristic policy bring
+// their own, everything else uses the Manhattan distance above.
+template<typename Graph>
+inline int heuristic(const Graph&, typename Graph::Location a, typename Graph::Location b) {
+	return heuristic(a, b);
+}
+
+template<typename Connectivity, typename Heuristic>
+inline int heuristic(const PolicyGrid<Connectivity, Heuristic>& graph, DenseGrid::Location a, DenseGrid::Location b) {
+	return graph.heuristic(a, b);
+}
+
+// Estimated on the original locations; needs a heuristic(L, L) overload.
+template<typename L>
+inline int heuristic(const CSRGraph<L>& graph, int a, int b) {
+	return heuristic(graph.node(a), graph.node(b));
+}
+
+// Default heuristic policy of a_star_search. A policy is anything that can
+// be called as estimate(a, b) and returns a lower bound on the cost from a
+// to b; the bucket and radix frontiers also need it to be consistent.
+template<typename Graph>
+struct GraphHeuristic {
+	const Graph& graph;
+
+	explicit GraphHeuristic(const Graph& graph_) : graph(graph_) {}
+
+	inline int operator()(typename Graph::Location a, typename Graph::Location b) const {
+		return heuristic(graph, a, b);
+	}
+};
+
+template<typename Graph, typename Frontier, typename Heuristic>
+void a_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far,
+Frontier& frontier,
+const Heuristic& estimate)
+{
+	typedef typename Graph::Location Location;
+	frontier.clear();
+	frontier.put(start, 0);
+
+	came_from[start] = start;
+	cost_so_far[start] = 0;
+
+	while (!frontier.empty()) {
+		auto current = frontier.get();
+
+		if (current == goal) {
+			break;
+		}
+
+		for_each_edge(graph, current, [&](Location next, int step) {
+			int new_cost = cost_so_far[current] + step;
+			if (!cost_so_far.count(next) || new_cost < cost_so_far[next]) {
+				cost_so_far[next] = new_cost;
+				int priority = new_cost + estimate(next, goal);
+				frontier.put(next, priority);
+				came_from[next] = current;
+			}
+		});
+	}
+}
+
+template<typename Graph, typename Frontier>
+void a_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far,
+Frontier& frontier)
+{
+	a_star_search(graph, start, goal, came_from, cost_so_far, frontier, GraphHeuristic<Graph>(graph));
+}
+
+template<typename Graph>
+void a_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	PriorityQueue<typename Graph::Location> frontier;
+	a_star_search(graph, start, goal, came_from, cost_so_far, frontier);
+}
+
+// Reusable search state for dense grids. The arrays are sized for the grid
+// once and a new search only bumps the generation stamp, so starting one is
+// O(1). Once the frontier and path buffers have grown to their working
+// size, repeated searches no longer allocate.
+template<typename Graph, typename Frontier = BucketQueue<int> >
+struct SearchWorkspace {
+	typedef typename Graph::Location Location;
+
+	vector<int> came_from;
+	vector<int> cost_so_far;
+	vector<unsigned> visited;
+	unsigned generation;
+	Frontier frontier;
+	// breadth first queue; every cell enters it at most once per search
+	vector<int> fifo;
+	vector<Location> path;
+
+	explicit SearchWorkspace(const Graph& graph)
+		: came_from(graph.size()), cost_so_far(graph.size()), visited(graph.size(), 0),
+		generation(0), fifo(graph.size()) {}
+
+	void begin() {
+		if (++generation == 0) {
+			std::fill(visited.begin(), visited.end(), 0);
+			generation = 1;
+		}
+		frontier.clear();
+	}
+
+	inline bool reached(int index) const {
+		return visited[index] == generation;
+	}
+
+	inline void visit(int index, int parent, int cost) {
+		visited[index] = generation;
+		came_from[index] = parent;
+		cost_so_far[index] = cost;
+	}
+
+	// Same goal-to-start order as reconstruct_path, written into the path
+	// buffer. Empty when the last search did not reach goal.
+	const vector<Location>& reconstruct_path(const Graph& graph, Location start, Location goal) {
+		path.clear();
+		int s = graph.index(start);
+		int current = graph.index(goal);
+		if (!reached(current)) {
+			return path;
+		}
+		path.push_back(goal);
+		while (current != s) {
+			current = came_from[current];
+			path.push_back(graph.location(current));
+		}
+		return path;
+	}
+};
+
+template<typename Graph, typename Frontier>
+bool breadth_first_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& workspace)
+{
+	typedef typename Graph::Location Location;
+	workspace.begin();
+	int s = graph.index(start), t = graph.index(goal);
+	size_t head = 0, tail = 0;
+	workspace.fifo[tail++] = s;
+	workspace.visit(s, s, 0);
+
+	while (head < tail) {
+		int current = workspace.fifo[head++];
+
+		if (current == t) {
+			return true;
+		}
+
+		graph.for_each_neighbor(graph.location(current), [&](Location next) {
+			int n = graph.index(next);
+			if (!workspace.reached(n)) {
+				workspace.fifo[tail++] = n;
+				workspace.visit(n, current, workspace.cost_so_far[current] + 1);
+			}
+		});
+	}
+	return false;
+}
+
+template<typename Graph, typename Frontier>
+bool dijkstra_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& workspace)
+{
+	typedef typename Graph::Location Location;
+	workspace.begin();
+	int s = graph.index(start), t = graph.index(goal);
+	workspace.frontier.put(s, 0);
+	workspace.visit(s, s, 0);
+
+	while (!workspace.frontier.empty()) {
+		int current = workspace.frontier.get();
+
+		if (current == t) {
+			return true;
+		}
+
+		Location id = graph.location(current);
+		for_each_edge(graph, id, [&](Location next, int step) {
+			int n = graph.index(next);
+			int new_cost = workspace.cost_so_far[current] + step;
+			if (!workspace.reached(n) || new_cost < workspace.cost_so_far[n]) {
+				workspace.visit(n, current, new_cost);
+				workspace.frontier.put(n, new_cost);
+			}
+		});
+	}
+	return false;
+}
+
+template<typename Graph, typename Frontier, typename Heuristic>
+bool a_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& workspace,
+const Heuristic& estimate)
+{
+	typedef typename Graph::Location Location;
+	workspace.begin();
+	int s = graph.index(start), t = graph.index(goal);
+	workspace.frontier.put(s, 0);
+	workspace.visit(s, s, 0);
+
+	while (!workspace.frontier.empty()) {
+		int current = workspace.frontier.get();
+
+		if (current == t) {
+			return true;
+		}
+
+		Location id = graph.location(current);
+		for_each_edge(graph, id, [&](Location next, int step) {
+			int n = graph.index(next);
+			int new_cost = workspace.cost_so_far[current] + step;
+			if (!workspace.reached(n) || new_cost < workspace.cost_so_far[n]) {
+				workspace.visit(n, current, new_cost);
+				workspace.frontier.put(n, new_cost + estimate(next, goal));
+			}
+		});
+	}
+	return false;
+}
+
+template<typename Graph, typename Frontier>
+bool a_star_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& workspace)
+{
+	return a_star_search(graph, start, goal, workspace, GraphHeuristic<Graph>(graph));
+}
+
+
+// Bidirectional searches: one frontier grows from start and one from goal,
+// and the search stops once the cheapest connection between them is
+// certain. Two circles of half the radius cover far less ground than one
+// full circle. The goal side walks edges backwards, so every edge needs a
+// way back, as on SquareGrid and DenseGrid; the step costs may differ per
+// direction. Once done, came_from and cost_so_far hold the joined path,
+// so reconstruct_path works as after a one-sided search.
+template<typename Graph>
+void bidirectional_breadth_first_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	typedef typename Graph::Location Location;
+	typedef typename SearchStorage<Graph>::CameFrom CameFrom;
+	typedef typename SearchStorage<Graph>::CostSoFar CostSoFar;
+	// side 0 grows from start, side 1 from goal with links toward goal
+	CameFrom toward_goal = SearchStorage<Graph>::make_came_from(graph);
+	CostSoFar cost_to_goal = SearchStorage<Graph>::make_cost_so_far(graph);
+	CameFrom* parents[2] = { &came_from, &toward_goal };
+	CostSoFar* costs[2] = { &cost_so_far, &cost_to_goal };
+	vector<Location> layers[2] = { vector<Location>(1, start), vector<Location>(1, goal) };
+	vector<Location> next_layer;
+
+	came_from[start] = start;
+	cost_so_far[start] = 0;
+	toward_goal[goal] = goal;
+	cost_to_goal[goal] = 0;
+
+	int best = start == goal ? 0 : INT_MAX;
+	Location meet = start;
+	// Expands whole layers of the smaller side. Any connection found in a
+	// layer is at most one step longer than the shortest path, so the best
+	// one of that layer is the shortest.
+	while (best == INT_MAX && !layers[0].empty() && !layers[1].empty()) {
+		int side = layers[0].size() <= layers[1].size() ? 0 : 1;
+		CameFrom& mine = *parents[side];
+		CostSoFar& cost = *costs[side];
+		CostSoFar& other = *costs[1 - side];
+		next_layer.clear();
+		for (auto current : layers[side]) {
+			graph.for_each_neighbor(current, [&](Location next) {
+				if (!mine.count(next)) {
+					next_layer.push_back(next);
+					mine[next] = current;
+					cost[next] = cost[current] + 1;
+				}
+				if (other.count(next) && cost[next] + other[next] < best) {
+					best = cost[next] + other[next];
+					meet = next;
+				}
+			});
+		}
+		layers[side].swap(next_layer);
+	}
+	if (best == INT_MAX) {
+		return;
+	}
+
+	for (Location current = meet; current != goal;) {
+		Location next = toward_goal[current];
+		came_from[next] = current;
+		cost_so_far[next] = cost_so_far[current] + 1;
+		current = next;
+	}
+}
+
+template<typename Graph>
+void bidirectional_dijkstra_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+typename SearchStorage<Graph>::CameFrom& came_from,
+typename SearchStorage<Graph>::CostSoFar& cost_so_far)
+{
+	typedef typename Graph::Location Location;
+	typedef typename SearchStorage<Graph>::CameFrom CameFrom;
+	typedef typename SearchStorage<Graph>::CostSoFar CostSoFar;
+	CameFrom toward_goal = SearchStorage<Graph>::make_came_from(graph);
+	CostSoFar cost_to_goal = SearchStorage<Graph>::make_cost_so_far(graph);
+	CameFrom* parents[2] = { &came_from, &toward_goal };
+	CostSoFar* costs[2] = { &cost_so_far, &cost_to_goal };
+	PriorityQueue<Location> frontiers[2];
+	frontiers[0].put(start, 0);
+	frontiers[1].put(goal, 0);
+
+	came_from[start] = start;
+	cost_so_far[start] = 0;
+	toward_goal[goal] = goal;
+	cost_to_goal[goal] = 0;
+
+	int best = start == goal ? 0 : INT_MAX;
+	Location meet = start;
+	// Each side takes locations in order of cost, so nothing left in its
+	// frontier is closer than its radius. Once the radii add up to best no
+	// cheaper connection is left.
+	int radius[2] = { 0, 0 };
+	while (!frontiers[0].empty() && !frontiers[1].empty() && radius[0] + radius[1] < best) {
+		int side = radius[0] <= radius[1] ? 0 : 1;
+		CameFrom& mine = *parents[side];
+		CostSoFar& cost = *costs[side];
+		CostSoFar& other = *costs[1 - side];
+		auto current = frontiers[side].get();
+		radius[side] = std::max(radius[side], cost[current]);
+
+		for_each_edge(graph, current, [&](Location next, int step) {
+			int new_cost = cost[current] + (side == 0 ? step : graph.cost(next, current));
+			if (!cost.count(next) || new_cost < cost[next]) {
+				cost[next] = new_cost;
+				frontiers[side].put(next, new_cost);
+				mine[next] = current;
+			}
+			if (other.count(next) && cost[next] + other[next] < best) {
+				best = cost[next] + other[next];
+				meet = next;
+			}
+		});
+	}
+	if (best == INT_MAX) {
+		return;
+	}
+
+	for (Location current = meet; current != goal;) {
+		Location next = toward_goal[current];
+		came_from[next] = current;
+		cost_so_far[next] = cost_so_far[current] + graph.cost(current, next);
+		current = next;
+	}
+}
+
+// Workspace versions: forward searches from start and ends up holding the
+// joined path, see SearchWorkspace::reconstruct_path; backward is scratch.
+template<typename Graph, typename Frontier>
+bool bidirectional_breadth_first_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& forward,
+SearchWorkspace<Graph, Frontier>& backward)
+{
+	typedef typename Graph::Location Location;
+	SearchWorkspace<Graph, Frontier>* sides[2] = { &forward, &backward };
+	int roots[2] = { graph.index(start), graph.index(goal) };
+	// each fifo holds the current layer in [head, tail)
+	size_t head[2] = { 0, 0 }, tail[2] = { 1, 1 };
+	for (int side = 0; side < 2; ++side) {
+		sides[side]->begin();
+		sides[side]->fifo[0] = roots[side];
+		sides[side]->visit(roots[side], roots[side], 0);
+	}
+
+	int best = roots[0] == roots[1] ? 0 : INT_MAX;
+	int meet = roots[0];
+	while (best == INT_MAX && head[0] < tail[0] && head[1] < tail[1]) {
+		int side = tail[0] - head[0] <= tail[1] - head[1] ? 0 : 1;
+		SearchWorkspace<Graph, Frontier>& mine = *sides[side];
+		SearchWorkspace<Graph, Frontier>& other = *sides[1 - side];
+		for (size_t end = tail[side]; head[side] < end; ++head[side]) {
+			int current = mine.fifo[head[side]];
+			graph.for_each_neighbor(graph.location(current), [&](Location next) {
+				int n = graph.index(next);
+				if (!mine.reached(n)) {
+					mine.fifo[tail[side]++] = n;
+					mine.visit(n, current, mine.cost_so_far[current] + 1);
+				}
+				if (other.reached(n) && mine.cost_so_far[n] + other.cost_so_far[n] < best) {
+					best = mine.cost_so_far[n] + other.cost_so_far[n];
+					meet = n;
+				}
+			});
+		}
+	}
+	if (best == INT_MAX) {
+		return false;
+	}
+
+	for (int current = meet; current != roots[1];) {
+		int next = backward.came_from[current];
+		forward.visit(next, current, forward.cost_so_far[current] + 1);
+		current = next;
+	}
+	return true;
+}
+
+template<typename Graph, typename Frontier>
+bool bidirectional_dijkstra_search
+(const Graph& graph,
+typename Graph::Location start,
+typename Graph::Location goal,
+SearchWorkspace<Graph, Frontier>& forward,
+SearchWorkspace<Graph, Frontier>& backward)
+{
+	typedef typename Graph::Location Location;
+	SearchWorkspace<Graph, Frontier>* sides[2] = { &forward, &backward };
+	int roots[2] = { graph.index(start), graph.index(goal) };
+	for (int side = 0; side < 2; ++side) {
+		sides[side]->begin();
+		sides[side]->frontier.put(roots[side], 0);
+		sides[side]->visit(roots[side], roots[side], 0);
+	}
+
+	int best = roots[0] == roots[1] ? 0 : INT_MAX;
+	int meet = roots[0];
+	int radius[2] = { 0, 0 };
+	while (!forward.frontier.empty() && !backward.frontier.empty() && radius[0] + radius[1] < best) {
+		int side = radius[0] <= radius[1] ? 0 : 1;
+		SearchWorkspace<Graph, Frontier>& mine = *sides[side];
+		SearchWorkspace<Graph, Frontier>& other = *sides[1 - side];
+		int current = mine.frontier.get();
+		radius[side] = std::max(radius[side], mine.cost_so_far[current]);
+
+		Location id = graph.location(current);
+		for_each_edge(graph, id, [&](Location next, int step) {
+			int n = graph.index(next);
+			int new_cost = mine.cost_so_far[current] + (side == 0 ? step : graph.cost(next, id));
+			if (!mine.reached(n) || new_cost < mine.cost_so_far[n]) {
+				mine.visit(n, current, new_cost);
+				mine.frontier.put(n, new_cost);
+			}
+			if (other.reached(n) && mine.cost_so_far[n] + other.cost_so_far[n] < best) {
+				best = mine.cost_so_far[n] + other.cost_so_far[n];
+				meet = n;
+			}
+		});
+	}
+	if (best == INT_MAX) {
+		return false;
+	}
+
+	for (int current = meet; current != roots[1];) {
+		int next = backward.came_from[current];
+		forward.visit(next, current, forward.cost_so_far[current] + graph.cost(graph.location(current), graph.location(next)));
+		current = next;
+	}
+	return true;
+}
+
+
+// D* Lite: incremental planner rooted at goal. It keeps g/rhs values for
+// every cell between calls, so after set_wall() only the cells whose
+// distance to goal actually changed are expanded again. With a start set
+// compute() stops as soon as the start is settled; without one it repairs
+// the whole distance field.
+template<typename Grid>
+struct DStarLite {
+	typedef typename Grid::Location Location;
+	typedef pair<int, int> Key;
+	typedef pair<Key, int> QueueElement;
+	enum { INF = INT_MAX / 2 };
+
+	Grid grid;
+	Location goal;
+	Location start;
+	bool has_start;
+	int km;
+	vector<int> g;
+	vector<int> rhs;
+	priority_queue<QueueElement, vector<QueueElement>, std::greater<QueueElement> > open;
+	// cells whose g value or passability changed since clear_changed()
+	vector<int> changed;
+	DenseBitset marked;
+
+	DStarLite(const Grid& grid_, Location goal_)
+		: grid(grid_), goal(goal_), start(goal_), has_start(false), km(0),
+		g(grid_.size(), INF), rhs(grid_.size(), INF), marked(grid_.size()) {
+		// the first field comes from a plain reverse search
+		typename SearchStorage<Grid>::CameFrom came_from = SearchStorage<Grid>::make_came_from(grid);
+		typename SearchStorage<Grid>::CostSoFar cost_so_far = SearchStorage<Grid>::make_cost_so_far(grid);
+		reverse_dijkstra_search(grid, goal, came_from, cost_so_far);
+		for (int i = 0; i < grid.size(); ++i) {
+			Location id = grid.location(i);
+			if (cost_so_far.count(id)) {
+				g[i] = rhs[i] = cost_so_far[id];
+			}
+		}
+	}
+
+	inline int distance(Location id) const {
+		return g[grid.index(id)];
+	}
+
+	void set_start(Location start_) {
+		if (has_start) {
+			km += heuristic(start, start_);
+		}
+		start = start_;
+		has_start = true;
+	}
+
+	void clear_start() {
+		has_start = false;
+	}
+
+	void set_wall(Location id, bool wall) {
+		if (grid.passable(id) != wall) {
+			return;
+		}
+		if (wall) {
+			grid.add_wall(id);
+		}
+		else {
+			grid.remove_wall(id);
+		}
+		int i = grid.index(id);
+		mark_changed(i);
+		update_vertex(i);
+		for (auto next : grid.neighbors(id)) {
+			update_vertex(grid.index(next));
+		}
+	}
+
+	// Returns the number of cells expanded.
+	int compute() {
+		int expanded = 0;
+		while (!open.empty()) {
+			Key k_old = open.top().first;
+			int u = open.top().second;
+			if (has_start) {
+				int s = grid.index(start);
+				if (!(k_old < calculate_key(s)) && rhs[s] == g[s]) {
+					break;
+				}
+			}
+			open.pop();
+
+			if (g[u] == rhs[u]) {
+				continue;
+			}
+			Key k_new = calculate_key(u);
+			if (k_old < k_new) {
+				open.emplace(k_new, u);
+				continue;
+			}
+
+			++expanded;
+			if (g[u] > rhs[u]) {
+				set_g(u, rhs[u]);
+			}
+			else {
+				set_g(u, INF);
+				update_vertex(u);
+			}
+			for (auto next : grid.neighbors(grid.location(u))) {
+				update_vertex(grid.index(next));
+			}
+		}
+		return expanded;
+	}
+
+	// The neighbor of id with the cheapest way to goal. Also works from
+	// inside a wall, so agents caught there can walk out.
+	bool next_step(Location id, Location& next) const {
+		if (id == goal) {
+			return false;
+		}
+		int best = INF;
+		for (auto candidate : grid.neighbors(id)) {
+			int j = grid.index(candidate);
+			if (g[j] < INF && g[j] + grid.cost(id, candidate) < best) {
+				best = g[j] + grid.cost(id, candidate);
+				next = candidate;
+			}
+		}
+		return best < INF;
+	}
+
+	// Path from start to goal, empty when the goal is cut off.
+	vector<Location> path() const {
+		vector<Location> result;
+		if (!has_start || distance(start) >= INF) {
+			return result;
+		}
+		Location current = start;
+		result.push_back(current);
+		while (current != goal && next_step(current, current)) {
+			result.push_back(current);
+		}
+		return result;
+	}
+
+	void clear_changed() {
+		for (int i : changed) {
+			marked.reset(i);
+		}
+		changed.clear();
+	}
+
+private:
+	Key calculate_key(int i) const {
+		int m = std::min(g[i], rhs[i]);
+		int h = has_start ? heuristic(start, grid.location(i)) : 0;
+		return Key(m + h + km, m);
+	}
+
+	void update_vertex(int i) {
+		if (i != grid.index(goal)) {
+			Location id = grid.location(i);
+			int best = INF;
+			if (grid.passable(id)) {
+				for (auto next : grid.neighbors(id)) {
+					int j = grid.index(next);
+					if (g[j] < INF) {
+						best = std::min(best, g[j] + grid.cost(id, next));
+					}
+				}
+			}
+			rhs[i] = best;
+		}
+		if (g[i] != rhs[i]) {
+			open.emplace(calculate_key(i), i);
+		}
+	}
+
+	void set_g(int i, int value) {
+		if (g[i] != value) {
+			g[i] = value;
+			mark_changed(i);
+		}
+	}
+
+	void mark_changed(int i) {
+		if (!marked.test(i)) {
+			marked.set(i);
+			changed.push_back(i);
+		}
+	}
+};
@@ -29,6 +29,14 @@ public:
 	virtual void Update(float timeStep);
 
 	void SetInitialCost(int cost) { initialCost_ = cost; }
+	/// Money returned when the tower is sold.
+	int GetSellValue() const { return initialCost_ / 2; }
+	void SetTile(const IntVector2& tile) { tile_ = tile; }
+	const IntVector2& GetTile() const { return tile_; }
+	/// Return the shooting range in world units.
+	float GetRange() const { return range_; }
+	/// Return the damage dealt per second while an enemy is in range.
+	float GetDamagePerSecond() const { return damage_ * fireRate_; }
 	void SetEnemies(Vector<WeakPtr<Node>> *enemies) { enemies_ = enemies; }
 	Node* GetNearestEnemy();
 	void Shoot();
@@ -60,6 +68,7 @@ protected:
 	int damagePrize_ = BASE_PRIZE;
 
 	int initialCost_ = 0;
+	IntVector2 tile_;
 
 private:
 };
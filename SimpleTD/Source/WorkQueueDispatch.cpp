@@ -0,0 +1,35 @@
+#include "WorkQueueDispatch.h"
+#include "Context.h"
+#include "WorkQueue.h"
+
+WorkQueueDispatch::WorkQueueDispatch(Context* context) :
+queue_(context->GetSubsystem<WorkQueue>())
+{
+}
+
+int WorkQueueDispatch::workers() const
+{
+	return (int)queue_->GetNumThreads() + 1;
+}
+
+void WorkQueueDispatch::run(int jobs, const std::function<void(int, int)>& job)
+{
+	for (int i = 0; i < jobs; ++i)
+	{
+		SharedPtr<WorkItem> item(new WorkItem());
+		item->workFunction_ = RunJob;
+		item->start_ = (void*)(size_t)i;
+		item->aux_ = (void*)&job;
+		item->priority_ = M_MAX_UNSIGNED;
+		queue_->AddWorkItem(item);
+	}
+
+	// the main thread takes jobs as thread 0 until the queue is empty
+	queue_->Complete(M_MAX_UNSIGNED);
+}
+
+void WorkQueueDispatch::RunJob(const WorkItem* item, unsigned threadIndex)
+{
+	const std::function<void(int, int)>& job = *(const std::function<void(int, int)>*)item->aux_;
+	job((int)(size_t)item->start_, (int)threadIndex);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Object.h"
+
+#include <functional>
+
+namespace Urho3D
+{
+	class WorkQueue;
+	struct WorkItem;
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Dispatcher for BatchPathfinder that runs the jobs on the engine's worker threads. The main
+/// thread works on the jobs too while it waits, and each job is told the index of the thread
+/// running it, so the workers can keep one search workspace per thread.
+class WorkQueueDispatch
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	WorkQueueDispatch(Context* context);
+
+	/// Return the number of worker indices handed to the jobs: the worker threads plus the main thread.
+	int workers() const;
+	/// Queue job(index, worker) for every index below jobs and wait until all are done.
+	void run(int jobs, const std::function<void(int, int)>& job);
+
+protected:
+	/// Work item entry point; calls the job stored in aux_ for the index stored in start_.
+	static void RunJob(const WorkItem* item, unsigned threadIndex);
+
+	WorkQueue* queue_;
+};